@@ -0,0 +1,551 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/platform/linux/webview_linux_data_server.h"
+#include "webview/webview_data_stream.h"
+#include "webview/webview_data_stream_memory.h"
+#include "base/algorithm.h"
+#include "base/basic_types.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QProcess>
+#include <QtNetwork/QTcpSocket>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Drives the loopback data server the same way the web views do, with
+// synthetic streams, so that the serving path can be measured alone:
+//
+//   concurrent - many keep-alive connections asking for small bodies,
+//   assets     - a storm of short connections, one asset per each,
+//   stream     - one connection reading a large body by Range slices,
+//   redirect   - requests proxied to --redirect-host, if one is given.
+//
+// Each scenario runs in a process of its own, as the peak RSS reported
+// with it only grows. It includes the client side buffers as well.
+
+namespace Webview {
+namespace {
+
+constexpr auto kSecret = "benchmark";
+
+// Bytes made from their positions, nothing is kept in memory.
+class SyntheticStream final : public DataStream {
+public:
+	explicit SyntheticStream(std::int64_t size) : _size(size) {
+	}
+
+	[[nodiscard]] std::int64_t size() override {
+		return _size;
+	}
+	[[nodiscard]] std::string mime() override {
+		return "application/octet-stream";
+	}
+
+	std::int64_t seek(int origin, std::int64_t position) override {
+		const auto base = (origin == SEEK_SET)
+			? 0
+			: (origin == SEEK_CUR)
+			? _offset
+			: (origin == SEEK_END)
+			? _size
+			: -1;
+		if (base < 0 || base + position < 0 || base + position > _size) {
+			return -1;
+		}
+		return (_offset = base + position);
+	}
+	std::int64_t read(void *buffer, std::int64_t requested) override {
+		if (requested < 0) {
+			return -1;
+		}
+		const auto copy = std::min(_size - _offset, requested);
+		const auto bytes = static_cast<unsigned char*>(buffer);
+		for (auto i = std::int64_t(); i != copy; ++i) {
+			bytes[i] = static_cast<unsigned char>((_offset + i) & 0xFF);
+		}
+		_offset += copy;
+		return copy;
+	}
+
+private:
+	const std::int64_t _size = 0;
+	std::int64_t _offset = 0;
+
+};
+
+[[nodiscard]] std::int64_t ParseNumber(std::string_view text) {
+	auto result = std::int64_t(-1);
+	const auto end = text.data() + text.size();
+	const auto parsed = std::from_chars(text.data(), end, result);
+	return (parsed.ec == std::errc() && parsed.ptr == end) ? result : -1;
+}
+
+[[nodiscard]] std::int64_t AssetSize(int index) {
+	return 512 + (std::int64_t(index) * 7919) % (64 * 1024);
+}
+
+// "bytes/<size>/<n>" or "asset/<n>".
+[[nodiscard]] std::unique_ptr<DataStream> MakeStream(std::string_view id) {
+	const auto slash = id.find('/');
+	if (slash == id.npos) {
+		return nullptr;
+	}
+	const auto kind = id.substr(0, slash);
+	const auto rest = id.substr(slash + 1);
+	if (kind == "bytes") {
+		const auto size = ParseNumber(rest.substr(0, rest.find('/')));
+		return (size >= 0)
+			? std::make_unique<SyntheticStream>(size)
+			: nullptr;
+	} else if (kind == "asset") {
+		static const auto mimes = std::array{
+			"text/css",
+			"text/javascript",
+			"image/png",
+			"font/woff2",
+		};
+		const auto index = ParseNumber(rest);
+		if (index < 0) {
+			return nullptr;
+		}
+		return std::make_unique<DataStreamFromMemory>(
+			QByteArray(AssetSize(index), char(index & 0xFF)),
+			mimes[index % mimes.size()]);
+	}
+	return nullptr;
+}
+
+// Single "bytes=from-till" range, clamped to the size.
+[[nodiscard]] std::optional<std::pair<std::int64_t, std::int64_t>> ParseRange(
+		std::string_view header,
+		std::int64_t size) {
+	constexpr auto prefix = std::string_view("bytes=");
+	if (!header.starts_with(prefix)) {
+		return std::nullopt;
+	}
+	header.remove_prefix(prefix.size());
+	const auto dash = header.find('-');
+	if (dash == header.npos) {
+		return std::nullopt;
+	}
+	const auto from = ParseNumber(header.substr(0, dash));
+	const auto last = (dash + 1 == header.size())
+		? (size - 1)
+		: ParseNumber(header.substr(dash + 1));
+	if (from < 0 || last < from || from >= size) {
+		return std::nullopt;
+	}
+	return std::make_pair(from, std::min(last + 1, size));
+}
+
+void Serve(
+		QTcpSocket *socket,
+		std::string_view id,
+		const HttpRequest &request,
+		const std::shared_ptr<HttpServer::Guard> &guard) {
+	auto stream = MakeStream(id);
+	if (!stream) {
+		socket->write("HTTP/1.1 404 Not Found\r\n");
+		socket->write("Content-Length: 0\r\n");
+		socket->write("\r\n");
+		guard->complete();
+		return;
+	}
+	const auto total = stream->size();
+	const auto range = ParseRange(request.header("Range"), total);
+	const auto from = range ? range->first : std::int64_t();
+	const auto till = range ? range->second : total;
+
+	socket->write(range
+		? "HTTP/1.1 206 Partial Content\r\n"
+		: "HTTP/1.1 200 OK\r\n");
+	socket->write("Content-Type: "
+		+ QByteArray::fromStdString(stream->mime())
+		+ "\r\n");
+	socket->write("Content-Length: "
+		+ QByteArray::number(till - from)
+		+ "\r\n");
+	if (range) {
+		socket->write("Content-Range: bytes "
+			+ QByteArray::number(from)
+			+ '-'
+			+ QByteArray::number(till - 1)
+			+ '/'
+			+ QByteArray::number(total)
+			+ "\r\n");
+	}
+	socket->write("\r\n");
+	stream->seek(SEEK_SET, from);
+	SendStream(socket, std::move(stream), till - from, [=](bool success) {
+		if (success) {
+			guard->complete();
+		}
+	});
+}
+
+struct Result {
+	std::vector<std::int64_t> latencies; // Microseconds.
+	std::int64_t bytes = 0;
+	std::int64_t elapsed = 0; // Microseconds.
+	std::int64_t startRss = 0; // Kilobytes.
+	std::int64_t peakRss = 0; // Kilobytes.
+	int failed = 0;
+};
+
+struct Scenario {
+	const char *name = nullptr;
+	int connections = 0;
+	int requests = 0; // Per connection.
+	bool close = false; // Each request on its own connection.
+	Fn<QByteArray(int connection, int index)> target;
+	Fn<QByteArray(int connection, int index)> headers;
+};
+
+// Minimal HTTP/1.1 client, sends the next request only after the whole
+// previous response was received, as the web process does per socket.
+class Client final {
+public:
+	Client(
+		const HttpServer::Endpoint &endpoint,
+		const Scenario &scenario,
+		int index,
+		not_null<Result*> result,
+		Fn<void()> finished);
+	~Client();
+
+private:
+	void connectSocket();
+	void sendNext();
+	void received();
+	void fail();
+	void finish();
+
+	const QString _host;
+	const std::uint16_t _port = 0;
+	const Scenario &_scenario;
+	const int _index = 0;
+	const not_null<Result*> _result;
+	Fn<void()> _finished;
+
+	QTcpSocket *_socket = nullptr;
+	QByteArray _buffer;
+	QElapsedTimer _timer;
+	std::int64_t _bodyLeft = -1; // -1 while reading the head.
+	int _completed = 0;
+
+};
+
+Client::Client(
+	const HttpServer::Endpoint &endpoint,
+	const Scenario &scenario,
+	int index,
+	not_null<Result*> result,
+	Fn<void()> finished)
+: _host(QString::fromStdString(endpoint.host))
+, _port(endpoint.port)
+, _scenario(scenario)
+, _index(index)
+, _result(result)
+, _finished(std::move(finished)) {
+	connectSocket();
+}
+
+Client::~Client() {
+	delete _socket;
+}
+
+void Client::connectSocket() {
+	if (_socket) {
+		QObject::disconnect(_socket, nullptr, nullptr, nullptr);
+		_socket->abort();
+		_socket->deleteLater();
+	}
+	_socket = new QTcpSocket();
+	_buffer = QByteArray();
+	_bodyLeft = -1;
+	_timer.start();
+
+	const auto socket = _socket;
+	QObject::connect(socket, &QTcpSocket::connected, [=] {
+		sendNext();
+	});
+	QObject::connect(socket, &QTcpSocket::readyRead, [=] {
+		received();
+	});
+	QObject::connect(socket, &QTcpSocket::disconnected, [=] {
+		fail();
+	});
+	QObject::connect(socket, &QTcpSocket::errorOccurred, [=] {
+		fail();
+	});
+	socket->connectToHost(_host, _port);
+}
+
+void Client::sendNext() {
+	const auto index = _completed;
+	auto head = QByteArray("GET /")
+		+ kSecret
+		+ '/'
+		+ _scenario.target(_index, index)
+		+ " HTTP/1.1\r\n"
+		+ "Host: "
+		+ _host.toUtf8()
+		+ ':'
+		+ QByteArray::number(_port)
+		+ "\r\n";
+	if (_scenario.headers) {
+		head += _scenario.headers(_index, index);
+	}
+	if (_scenario.close) {
+		head += "Connection: close\r\n";
+	} else {
+		_timer.start();
+	}
+	_socket->write(head + "\r\n");
+}
+
+void Client::received() {
+	_buffer += _socket->readAll();
+	while (!_buffer.isEmpty()) {
+		if (_bodyLeft < 0) {
+			const auto end = _buffer.indexOf("\r\n\r\n");
+			if (end < 0) {
+				return;
+			}
+			const auto head = _buffer.left(end + 2);
+			_buffer.remove(0, end + 4);
+			if (!head.startsWith("HTTP/1.1 200 ")
+				&& !head.startsWith("HTTP/1.1 206 ")) {
+				fail();
+				return;
+			}
+			const auto key = QByteArray("\r\ncontent-length:");
+			const auto position = head.toLower().indexOf(key);
+			if (position < 0) {
+				fail();
+				return;
+			}
+			const auto start = position + key.size();
+			const auto line = head.indexOf("\r\n", start);
+			_bodyLeft = head.mid(start, line - start).trimmed().toLongLong();
+		}
+		const auto take = std::min(std::int64_t(_buffer.size()), _bodyLeft);
+		_buffer.remove(0, take);
+		_bodyLeft -= take;
+		_result->bytes += take;
+		if (_bodyLeft > 0) {
+			return;
+		}
+		_result->latencies.push_back(_timer.nsecsElapsed() / 1000);
+		_bodyLeft = -1;
+		if (++_completed == _scenario.requests) {
+			finish();
+			return;
+		} else if (_scenario.close) {
+			connectSocket();
+			return;
+		}
+		sendNext();
+	}
+}
+
+void Client::fail() {
+	if (_completed < _scenario.requests) {
+		_result->failed += _scenario.requests - _completed;
+		_completed = _scenario.requests;
+		finish();
+	}
+}
+
+void Client::finish() {
+	QObject::disconnect(_socket, nullptr, nullptr, nullptr);
+	if (const auto finished = ::base::take(_finished)) {
+		finished();
+	}
+}
+
+[[nodiscard]] std::int64_t PeakRss() {
+	auto usage = rusage();
+	return getrusage(RUSAGE_SELF, &usage) ? 0 : std::int64_t(usage.ru_maxrss);
+}
+
+[[nodiscard]] Result Run(
+		const HttpServer::Endpoint &endpoint,
+		const Scenario &scenario) {
+	auto result = Result{ .startRss = PeakRss() };
+	auto loop = QEventLoop();
+	auto left = scenario.connections;
+	auto clients = std::vector<std::unique_ptr<Client>>();
+	auto timer = QElapsedTimer();
+	timer.start();
+	for (auto i = 0; i != scenario.connections; ++i) {
+		clients.push_back(std::make_unique<Client>(
+			endpoint,
+			scenario,
+			i,
+			&result,
+			[&] { if (!--left) loop.quit(); }));
+	}
+	loop.exec();
+	result.elapsed = timer.nsecsElapsed() / 1000;
+	result.peakRss = PeakRss();
+	return result;
+}
+
+void Print(const Scenario &scenario, Result result) {
+	auto &latencies = result.latencies;
+	std::sort(begin(latencies), end(latencies));
+	const auto percentile = [&](int value) {
+		return latencies.empty()
+			? 0.
+			: latencies[(latencies.size() - 1) * value / 100] / 1000.;
+	};
+	const auto seconds = std::max(result.elapsed, std::int64_t(1)) / 1e6;
+	std::printf(
+		"%-12s %8d ok %6d failed %8.3f s %10.1f req/s %9.1f MB/s"
+		" p50 %7.3f ms p99 %7.3f ms peak RSS %7.1f MB (+%.1f MB)\n",
+		scenario.name,
+		int(latencies.size()),
+		result.failed,
+		seconds,
+		latencies.size() / seconds,
+		result.bytes / seconds / (1024. * 1024.),
+		percentile(50),
+		percentile(99),
+		result.peakRss / 1024.,
+		(result.peakRss - result.startRss) / 1024.);
+}
+
+} // namespace
+} // namespace Webview
+
+int main(int argc, char *argv[]) {
+	using namespace Webview;
+
+	auto app = QCoreApplication(argc, argv);
+
+	auto parser = QCommandLineParser();
+	parser.addHelpOption();
+	const auto mainThread = QCommandLineOption(
+		"main-thread",
+		"Serve on the main thread instead of a dedicated one.");
+	const auto redirectHost = QCommandLineOption(
+		"redirect-host",
+		"Host to proxy the redirect scenario requests to over https.",
+		"host");
+	const auto redirectPath = QCommandLineOption(
+		"redirect-path",
+		"Path requested from the redirect host.",
+		"path",
+		"/");
+	const auto only = QCommandLineOption(
+		"scenario",
+		"Run only this scenario, in this process.",
+		"name");
+	parser.addOptions({ mainThread, redirectHost, redirectPath, only });
+	parser.process(app);
+
+	const auto host = parser.value(redirectHost).toUtf8();
+	const auto path = parser.value(redirectPath).toUtf8();
+
+	const auto streamSize = std::int64_t(64 * 1024 * 1024);
+	const auto sliceSize = std::int64_t(1024 * 1024);
+	const auto scenarios = std::vector<Scenario>{
+		{
+			.name = "concurrent",
+			.connections = 32,
+			.requests = 200,
+			.target = [](int connection, int index) -> QByteArray {
+				return "bytes/16384/" + QByteArray::number(index);
+			},
+		},
+		{
+			.name = "assets",
+			.connections = 256,
+			.requests = 4,
+			.close = true,
+			.target = [](int connection, int index) -> QByteArray {
+				return "asset/" + QByteArray::number(connection * 4 + index);
+			},
+		},
+		{
+			.name = "stream",
+			.connections = 1,
+			.requests = int(streamSize / sliceSize),
+			.target = [=](int connection, int index) -> QByteArray {
+				return "bytes/" + QByteArray::number(streamSize) + "/0";
+			},
+			.headers = [=](int connection, int index) -> QByteArray {
+				const auto from = index * sliceSize;
+				return "Range: bytes="
+					+ QByteArray::number(from)
+					+ '-'
+					+ QByteArray::number(from + sliceSize - 1)
+					+ "\r\n";
+			},
+		},
+		{
+			.name = "redirect",
+			.connections = 8,
+			.requests = 8,
+			.target = [=](int connection, int index) -> QByteArray {
+				return path.startsWith('/')
+					? (host + path)
+					: (host + '/' + path);
+			},
+		},
+	};
+	if (!parser.isSet(only)) {
+		const auto arguments = app.arguments().mid(1);
+		for (const auto &scenario : scenarios) {
+			if (scenario.name == std::string_view("redirect")
+				&& host.isEmpty()) {
+				std::printf(
+					"%-12s skipped, no --redirect-host\n",
+					scenario.name);
+				continue;
+			}
+			std::fflush(stdout);
+			QProcess::execute(
+				app.applicationFilePath(),
+				arguments + QStringList{
+					"--scenario",
+					QString::fromLatin1(scenario.name),
+				});
+		}
+		return 0;
+	}
+	const auto name = parser.value(only).toStdString();
+	const auto i = std::ranges::find_if(scenarios, [&](const auto &scenario) {
+		return (name == scenario.name);
+	});
+	if (i == end(scenarios)) {
+		std::fprintf(stderr, "Unknown scenario: %s\n", name.c_str());
+		return 1;
+	}
+
+	const auto server = DataServer::Acquire(!parser.isSet(mainThread));
+	const auto endpoint = server->addRoute(kSecret, host, Serve);
+	if (!endpoint) {
+		std::fprintf(stderr, "Could not start the data server.\n");
+		return 1;
+	}
+	Print(*i, Run(*endpoint, *i));
+	server->removeRoute(kSecret);
+	return 0;
+}
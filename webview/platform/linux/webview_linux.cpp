@@ -31,6 +31,20 @@ std::unique_ptr<Interface> CreateInstance(Config config) {
 	return WebKitGTK::CreateInstance(std::move(config));
 }
 
+void CreateInstanceAsync(
+		Config config,
+		Fn<void(std::unique_ptr<Interface>)> done) {
+	WebKitGTK::CreateInstanceAsync(std::move(config), std::move(done));
+}
+
+void SetHelperPoolSize(int size) {
+	WebKitGTK::SetHelperPoolSize(size);
+}
+
+void SetAvailabilityCachePath(const std::string &path) {
+	WebKitGTK::SetAvailabilityCachePath(path);
+}
+
 std::string GenerateStorageToken() {
 	constexpr auto kSize = 16;
 	auto result = std::string(kSize, ' ');
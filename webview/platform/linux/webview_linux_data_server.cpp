@@ -0,0 +1,123 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/platform/linux/webview_linux_data_server.h"
+
+#include "base/debug_log.h"
+
+#include <QtCore/QThread>
+#include <QtNetwork/QTcpServer>
+
+#include <algorithm>
+#include <array>
+
+namespace Webview {
+
+std::shared_ptr<DataServer> DataServer::Acquire(bool thread) {
+	static auto servers = std::array<std::weak_ptr<DataServer>, 2>();
+	auto &weak = servers[thread ? 1 : 0];
+	if (auto strong = weak.lock()) {
+		return strong;
+	}
+	auto result = std::make_shared<DataServer>(thread);
+	weak = result;
+	return result;
+}
+
+DataServer::DataServer(bool thread) {
+	if (thread) {
+		// Everything the server owns lives on its own thread, so that
+		// the sockets and the bytes pumped through them never touch main.
+		_thread = std::make_unique<QThread>();
+		_context = std::make_unique<QObject>();
+		_context->moveToThread(_thread.get());
+
+		// Whatever is still queued is dropped, the server is destroyed
+		// on its thread right before it ends.
+		QObject::connect(
+			_thread.get(),
+			&QThread::finished,
+			_context.get(),
+			[=] { _server.reset(); },
+			Qt::DirectConnection);
+		_thread->start();
+	}
+	invoke([=] { _server.emplace(); });
+}
+
+DataServer::~DataServer() {
+	if (_thread) {
+		_thread->quit();
+		_thread->wait();
+	} else {
+		_server.reset();
+	}
+}
+
+QObject *DataServer::context() const {
+	return _context.get();
+}
+
+auto DataServer::addRoute(
+		const QByteArray &password,
+		const QByteArray &redirectHost,
+		HttpServer::Handler handler) -> std::optional<HttpServer::Endpoint> {
+	removeRoute(password);
+	auto listener = ListenLoopback(_nextHost, [&](const QHostAddress &a) {
+		return std::ranges::find(_routes, a, &Route::address) != end(_routes);
+	});
+	if (!listener) {
+		LOG(("WebView Error: "
+			"No loopback address to serve data on, %1 routes are served."
+			).arg(int(_routes.size())));
+		return std::nullopt;
+	}
+	const auto address = listener->serverAddress();
+	const auto result = HttpServer::Endpoint{
+		.host = address.toString().toStdString(),
+		.port = listener->serverPort(),
+	};
+	_routes.push_back({ .password = password, .address = address });
+	if (_thread) {
+		listener->moveToThread(_thread.get());
+	}
+	const auto moved = std::make_shared<std::unique_ptr<QTcpServer>>(
+		std::move(listener));
+	invoke([=] {
+		_server->addRoute(
+			password,
+			redirectHost,
+			handler,
+			std::move(*moved));
+	});
+	return result;
+}
+
+void DataServer::removeRoute(const QByteArray &password) {
+	const auto i = std::ranges::find(_routes, password, &Route::password);
+	if (i == end(_routes)) {
+		return;
+	}
+	_routes.erase(i);
+	invoke([=] { _server->removeRoute(password); });
+}
+
+void DataServer::setRedirectCache(const QString &path, std::int64_t limit) {
+	invoke([=] { _server->setRedirectCache(path, limit); });
+}
+
+void DataServer::invoke(Fn<void()> callback) {
+	if (!_context) {
+		callback();
+		return;
+	}
+	QMetaObject::invokeMethod(
+		_context.get(),
+		std::move(callback),
+		Qt::QueuedConnection);
+}
+
+} // namespace Webview
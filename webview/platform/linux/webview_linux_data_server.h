@@ -0,0 +1,63 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "webview/platform/linux/webview_linux_http_server.h"
+
+#include <QtNetwork/QHostAddress>
+
+#include <optional>
+
+class QThread;
+
+namespace Webview {
+
+// Loopback server shared by all the instances in the process, serving
+// either on the main thread or on its own one. Each instance is served
+// under its own route and removes it before it is destroyed. Routes get
+// listeners on distinct loopback hosts, so each one is a separate origin,
+// which limits the process to 253 instances served at the same time.
+class DataServer final {
+public:
+	// Must be called on the main thread.
+	[[nodiscard]] static std::shared_ptr<DataServer> Acquire(bool thread);
+
+	explicit DataServer(bool thread);
+	~DataServer();
+
+	// Where the sockets live, nullptr if on the main thread.
+	[[nodiscard]] QObject *context() const;
+
+	// The listener is opened right here, so that the endpoint is known
+	// without waiting for the server thread. std::nullopt if it couldn't.
+	[[nodiscard]] std::optional<HttpServer::Endpoint> addRoute(
+		const QByteArray &password,
+		const QByteArray &redirectHost,
+		HttpServer::Handler handler);
+	void removeRoute(const QByteArray &password);
+	void setRedirectCache(const QString &path, std::int64_t limit);
+
+private:
+	struct Route {
+		QByteArray password;
+		QHostAddress address;
+	};
+
+	// Queues it to the server thread, never waiting for it.
+	void invoke(Fn<void()> callback);
+
+	std::optional<HttpServer> _server;
+	std::unique_ptr<QThread> _thread;
+	std::unique_ptr<QObject> _context;
+
+	// Addresses taken on the main thread, the server may lag behind.
+	std::vector<Route> _routes;
+	int _nextHost = 0;
+
+};
+
+} // namespace Webview
@@ -6,112 +6,787 @@
 //
 #include "webview/platform/linux/webview_linux_http_server.h"
 
-#include "base/basic_types.h"
+#include "webview/webview_data_metrics.h"
+#include "webview/webview_data_stream_file.h"
+#include "webview/webview_data_stream_mapped.h"
+#include "webview/webview_data_stream_memory.h"
+#include "webview/webview_interface.h"
+#include "base/algorithm.h"
+#include "base/random.h"
 
+#include <QtCore/QDateTime>
+#include <QtCore/QLocale>
 #include <QtCore/QPointer>
+#include <QtCore/QTimeZone>
 #include <QtCore/QUrl>
+#include <QtNetwork/QTcpServer>
 #include <QtNetwork/QTcpSocket>
 #include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkDiskCache>
 #include <QtNetwork/QNetworkReply>
 
 #include <crl/crl.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
 namespace Webview {
+namespace {
 
-struct HttpServer::Private {
-	void handleRequest(QTcpSocket *socket);
+constexpr auto kStreamSliceSize = std::int64_t(64 * 1024);
+constexpr auto kSocketBufferLimit = std::int64_t(256 * 1024);
+constexpr auto kMaxRequestHeadSize = 16 * 1024;
+// Deflated in one go on the thread serving the socket, which is the main
+// one unless the server thread is enabled, so only up to a few frames.
+constexpr auto kCompressSizeLimit = std::int64_t(1024 * 1024);
+constexpr auto kHttpDateFormat = "ddd, dd MMM yyyy hh:mm:ss 'GMT'";
+// Route listeners use 127.0.0.2 - 127.0.0.254, the whole 127.0.0.0/8 is
+// routed to the loopback interface on Linux.
+constexpr auto kLoopbackFirstHost = quint32(0x7F000002);
+constexpr auto kLoopbackHosts = 253;
 
-	bool processRedirect(
-		QTcpSocket *socket,
-		const QByteArray &id,
-		const ::base::flat_map<QByteArray, QByteArray> &headers,
-		const std::shared_ptr<Guard> &guard);
+[[nodiscard]] char ToLower(char ch) {
+	return (ch >= 'A' && ch <= 'Z') ? char(ch - 'A' + 'a') : ch;
+}
+
+[[nodiscard]] bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+	return (a.size() == b.size())
+		&& std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+			return ToLower(x) == ToLower(y);
+		});
+}
+
+// Doesn't stop at the first difference, so that the time it takes
+// tells nothing about how much of the secret was guessed right.
+[[nodiscard]] bool ConstantTimeEquals(std::string_view a, std::string_view b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	auto difference = 0;
+	for (auto i = std::size_t(); i != a.size(); ++i) {
+		difference |= (a[i] ^ b[i]);
+	}
+	return !difference;
+}
+
+[[nodiscard]] std::string_view Trimmed(std::string_view value) {
+	constexpr auto kSpaces = std::string_view(" \t\r");
+	const auto from = value.find_first_not_of(kSpaces);
+	if (from == value.npos) {
+		return {};
+	}
+	const auto till = value.find_last_not_of(kSpaces);
+	return value.substr(from, till - from + 1);
+}
+
+// Continues scanning from the first line that wasn't complete last time,
+// returns the request head size once its closing empty line is received.
+[[nodiscard]] int FindRequestHeadEnd(std::string_view buffer, int &scanned) {
+	while (true) {
+		const auto newline = buffer.find('\n', scanned);
+		if (newline == buffer.npos) {
+			return 0;
+		}
+		const auto line = buffer.substr(scanned, newline - scanned);
+		scanned = int(newline + 1);
+		if (line.empty() || line == "\r") {
+			return scanned;
+		}
+	}
+}
+
+[[nodiscard]] bool ParseRequestHead(
+		std::string_view head,
+		HttpRequest &request) {
+	const auto firstLineEnd = head.find('\n');
+	const auto firstLine = Trimmed(head.substr(0, firstLineEnd));
+	const auto methodEnd = firstLine.find(' ');
+	if (methodEnd == firstLine.npos) {
+		return false;
+	}
+	const auto targetEnd = firstLine.find(' ', methodEnd + 1);
+	request.method = firstLine.substr(0, methodEnd);
+	request.target = (targetEnd != firstLine.npos)
+		? firstLine.substr(methodEnd + 1, targetEnd - methodEnd - 1)
+		: firstLine.substr(methodEnd + 1);
+	request.version = (targetEnd != firstLine.npos)
+		? Trimmed(firstLine.substr(targetEnd + 1))
+		: std::string_view();
+	request.headersCount = 0;
+
+	auto from = (firstLineEnd != head.npos) ? (firstLineEnd + 1) : head.size();
+	while (from < head.size()) {
+		const auto till = std::min(head.find('\n', from), head.size());
+		const auto line = head.substr(from, till - from);
+		from = till + 1;
+
+		const auto separator = line.find(':');
+		if (separator == line.npos || !separator) {
+			continue;
+		} else if (request.headersCount == HttpRequest::kMaxHeaders) {
+			return false;
+		}
+		request.headers[request.headersCount++] = {
+			.name = Trimmed(line.substr(0, separator)),
+			.value = Trimmed(line.substr(separator + 1)),
+		};
+	}
+	return !request.method.empty() && request.target.starts_with('/');
+}
+
+[[nodiscard]] QByteArray HttpDate(std::int64_t seconds) {
+	return QLocale::c().toString(
+		QDateTime::fromSecsSinceEpoch(seconds, QTimeZone::utc()),
+		kHttpDateFormat).toLatin1();
+}
+
+[[nodiscard]] std::int64_t ParseHttpDate(std::string_view value) {
+	auto result = QLocale::c().toDateTime(
+		QString::fromLatin1(value.data(), value.size()),
+		kHttpDateFormat);
+	if (!result.isValid()) {
+		return 0;
+	}
+	result.setTimeZone(QTimeZone::utc());
+	return result.toSecsSinceEpoch();
+}
+
+// Returns the amount of bytes sent, zero if the socket is full.
+[[nodiscard]] std::int64_t SendFile(
+		qintptr socket,
+		DataStreamFromFile *file,
+		std::int64_t size) {
+	const auto position = file->seek(SEEK_CUR, 0);
+	if (position < 0) {
+		return -1;
+	}
+	auto offset = off_t(position);
+	const auto sent = sendfile(
+		int(socket),
+		file->handle(),
+		&offset,
+		size_t(size));
+	if (sent < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			? 0
+			: -1;
+	} else if (!sent || file->seek(SEEK_CUR, sent) < 0) {
+		return -1;
+	}
+	return sent;
+}
+
+// Same as SendFile, but writes straight from the mapped memory.
+[[nodiscard]] std::int64_t SendMapped(
+		qintptr socket,
+		DataStreamFromMappedFile *mapped,
+		std::int64_t size) {
+	const auto position = mapped->seek(SEEK_CUR, 0);
+	if (position < 0) {
+		return -1;
+	}
+	const auto sent = send(
+		int(socket),
+		mapped->bytes() + position,
+		size_t(size),
+		MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (sent < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			? 0
+			: -1;
+	} else if (!sent || mapped->seek(SEEK_CUR, sent) < 0) {
+		return -1;
+	}
+	return sent;
+}
+
+// Part headers and ranges of one stream, laid out as a multipart body.
+class ByteRanges final : public DataStream {
+public:
+	ByteRanges(
+		std::unique_ptr<DataStream> stream,
+		std::int64_t streamOffset,
+		std::int64_t total,
+		const std::vector<DataRange> &ranges);
+
+	[[nodiscard]] std::int64_t size() override;
+	[[nodiscard]] std::string mime() override;
+
+	std::int64_t seek(int origin, std::int64_t position) override;
+	std::int64_t read(void *buffer, std::int64_t requested) override;
+
+private:
+	struct Segment {
+		QByteArray bytes; // Part headers, if not a range of the stream.
+		std::int64_t from = -1;
+		std::int64_t length = 0;
+	};
+
+	std::unique_ptr<DataStream> _stream;
+	std::string _mime;
+	std::vector<Segment> _segments;
+	std::int64_t _size = 0;
+	std::int64_t _position = 0;
 
-	QNetworkAccessManager manager;
-	QByteArray password;
-	QByteArray redirectHost;
-	std::function<void(
-		QTcpSocket *socket,
-		const QByteArray &id,
-		const ::base::flat_map<QByteArray, QByteArray> &headers,
-		const std::shared_ptr<Guard> &guard)> handler;
 };
 
-void HttpServer::Private::handleRequest(QTcpSocket *socket) {
-	const auto guard = std::make_shared<Guard>(crl::guard(socket, [=] {
-		QMetaObject::invokeMethod(socket, [=] {
-			socket->disconnectFromHost();
+ByteRanges::ByteRanges(
+	std::unique_ptr<DataStream> stream,
+	std::int64_t streamOffset,
+	std::int64_t total,
+	const std::vector<DataRange> &ranges)
+: _stream(std::move(stream)) {
+	auto random = QByteArray(8, Qt::Uninitialized);
+	::base::RandomFill(random.data(), random.size());
+	const auto boundary = random.toHex();
+	const auto mime = QByteArray::fromStdString(_stream->mime());
+	_mime = "multipart/byteranges; boundary=" + boundary.toStdString();
+
+	const auto add = [&](Segment segment) {
+		if (segment.from < 0) {
+			segment.length = segment.bytes.size();
+		}
+		_size += segment.length;
+		_segments.push_back(std::move(segment));
+	};
+	for (const auto &range : ranges) {
+		add({
+			.bytes = (_segments.empty() ? "--" : "\r\n--")
+				+ boundary
+				+ "\r\nContent-Type: "
+				+ mime
+				+ "\r\nContent-Range: bytes "
+				+ QByteArray::number(range.offset)
+				+ '-'
+				+ QByteArray::number(range.offset + range.limit - 1)
+				+ '/'
+				+ QByteArray::number(total)
+				+ "\r\n\r\n",
 		});
-	}));
+		add({ .from = range.offset - streamOffset, .length = range.limit });
+	}
+	add({ .bytes = "\r\n--" + boundary + "--\r\n" });
+}
 
-	const auto firstLine = socket->readLine().simplified().split(' ');
-	if (firstLine.size() < 2 || firstLine[0] != "GET") {
-		return;
+std::int64_t ByteRanges::size() {
+	return _size;
+}
+
+std::string ByteRanges::mime() {
+	return _mime;
+}
+
+std::int64_t ByteRanges::seek(int origin, std::int64_t position) {
+	const auto base = (origin == SEEK_SET)
+		? 0
+		: (origin == SEEK_CUR)
+		? _position
+		: (origin == SEEK_END)
+		? _size
+		: -1;
+	if (base < 0 || base + position < 0 || base + position > _size) {
+		return -1;
 	}
+	_position = base + position;
+	return _position;
+}
 
-	const auto headers = [&] {
-		auto result = ::base::flat_map<QByteArray, QByteArray>();
-		while (true) {
-			const auto line = socket->readLine();
-			const auto separator = line.indexOf(':');
-			if (separator <= 0) {
-				break;
+std::int64_t ByteRanges::read(void *buffer, std::int64_t requested) {
+	const auto bytes = static_cast<char*>(buffer);
+	auto result = std::int64_t();
+	auto start = std::int64_t();
+	for (const auto &segment : _segments) {
+		const auto till = start + segment.length;
+		if (result < requested && _position < till) {
+			const auto skip = _position - start;
+			const auto count = std::min(till - _position, requested - result);
+			if (segment.from < 0) {
+				memcpy(bytes + result, segment.bytes.constData() + skip, count);
+			} else {
+				const auto from = segment.from + skip;
+				if (_stream->seek(SEEK_SET, from) != from
+					|| _stream->read(bytes + result, count) != count) {
+					return result ? result : -1;
+				}
 			}
+			result += count;
+			_position += count;
+		}
+		start = till;
+	}
+	return result;
+}
 
-			const auto name = line.mid(0, separator).simplified();
-			const auto value = line.mid(separator + 1).simplified();
-			result.emplace(name, value);
+[[nodiscard]] bool AcceptsEncoding(
+		std::string_view acceptEncoding,
+		std::string_view encoding) {
+	auto wildcard = false;
+	while (!acceptEncoding.empty()) {
+		const auto separator = std::min(
+			acceptEncoding.find(','),
+			acceptEncoding.size());
+		auto coding = Trimmed(acceptEncoding.substr(0, separator));
+		acceptEncoding.remove_prefix(
+			std::min(separator + 1, acceptEncoding.size()));
+		auto accepted = true;
+		if (const auto params = coding.find(';'); params != coding.npos) {
+			auto quality = Trimmed(coding.substr(params + 1));
+			coding = Trimmed(coding.substr(0, params));
+			if (quality.size() > 2
+				&& ToLower(quality[0]) == 'q'
+				&& quality[1] == '=') {
+				// Only "q=0", "q=0.0" and alike forbid the coding.
+				accepted = (quality.substr(2).find_first_not_of("0.")
+					!= std::string_view::npos);
+			}
 		}
-		return result;
-	}();
+		if (EqualsIgnoreCase(coding, encoding)) {
+			return accepted;
+		} else if (coding == "*") {
+			wildcard = accepted;
+		}
+	}
+	return wildcard;
+}
 
-	const auto getHeader = [&](const QByteArray &key) {
-		const auto it = headers.find(key);
-		return it != headers.end()
-			? it->second
-			: QByteArray();
+[[nodiscard]] bool Compressible(std::string_view mime) {
+	const auto has = [&](std::string_view part) {
+		return mime.find(part) != mime.npos;
 	};
+	return mime.starts_with("text/")
+		|| mime.starts_with("application/wasm")
+		|| has("javascript")
+		|| has("json")
+		|| has("xml");
+}
+
+// Reads the whole stream, leaving it at the beginning in any case.
+[[nodiscard]] std::unique_ptr<DataStream> Deflated(
+		DataStream &stream,
+		std::int64_t size) {
+	auto bytes = QByteArray();
+	if (const auto memory = dynamic_cast<DataStreamFromMemory*>(&stream)) {
+		bytes = memory->data();
+	} else {
+		bytes.resize(size);
+		auto read = std::int64_t();
+		while (read < size) {
+			const auto chunk = stream.read(bytes.data() + read, size - read);
+			if (chunk <= 0) {
+				break;
+			}
+			read += chunk;
+		}
+		stream.seek(SEEK_SET, 0);
+		if (read != size) {
+			return nullptr;
+		}
+	}
+
+	// qCompress() output is a zlib stream prefixed with four bytes of the
+	// uncompressed size, and a zlib stream is what "deflate" stands for.
+	auto compressed = qCompress(bytes);
+	if (compressed.size() <= 4 || compressed.size() - 4 >= size) {
+		return nullptr;
+	}
+	compressed.remove(0, 4);
+	return std::make_unique<DataStreamFromMemory>(
+		std::move(compressed),
+		stream.mime());
+}
+
+} // namespace
+
+std::string_view HttpRequest::header(std::string_view name) const {
+	for (auto i = 0; i != headersCount; ++i) {
+		if (EqualsIgnoreCase(headers[i].name, name)) {
+			return headers[i].value;
+		}
+	}
+	return {};
+}
+
+QByteArray FreshnessHeaders(
+		const DataFreshness &freshness,
+		std::string_view encoding) {
+	auto result = QByteArray();
+	if (!freshness.etag.empty()) {
+		result += "ETag: \"" + QByteArray::fromStdString(freshness.etag);
+		if (!encoding.empty()) {
+			result += '-' + QByteArray(encoding.data(), encoding.size());
+		}
+		result += "\"\r\n";
+	}
+	if (freshness.lastModified > 0) {
+		result += "Last-Modified: "
+			+ HttpDate(freshness.lastModified)
+			+ "\r\n";
+	}
+	if (freshness.maxAge > 0) {
+		result += "Cache-Control: max-age="
+			+ QByteArray::number(freshness.maxAge)
+			+ (freshness.immutable ? ", immutable\r\n" : "\r\n");
+	} else if (!freshness.etag.empty() || freshness.lastModified > 0) {
+		result += "Cache-Control: no-cache\r\n";
+	} else {
+		result += "Cache-Control: no-store\r\n";
+	}
+	return result;
+}
 
-	const auto authed = [&] {
-		const auto auth = getHeader("Authorization");
-		if (auth.startsWith("Basic ")) {
-			const auto userPass = QByteArray::fromBase64(auth.mid(6));
-			if (userPass == ':' + password) {
+std::unique_ptr<QTcpServer> ListenLoopback(
+		int &next,
+		Fn<bool(const QHostAddress &)> taken) {
+	for (auto i = 0; i != kLoopbackHosts; ++i) {
+		const auto index = (next + i) % kLoopbackHosts;
+		const auto address = QHostAddress(kLoopbackFirstHost + index);
+		if (taken(address)) {
+			continue;
+		}
+		auto result = std::make_unique<QTcpServer>();
+		if (result->listen(address)) {
+			next = (index + 1) % kLoopbackHosts;
+			return result;
+		}
+	}
+	return nullptr;
+}
+
+bool NotModified(
+		const DataFreshness &freshness,
+		std::string_view ifNoneMatch,
+		std::string_view ifModifiedSince,
+		std::string_view *encoding) {
+	const auto &etag = freshness.etag;
+	if (!ifNoneMatch.empty()) {
+		// If-None-Match takes precedence, If-Modified-Since is ignored.
+		if (freshness.etag.empty()) {
+			return false;
+		} else if (Trimmed(ifNoneMatch) == "*") {
+			return true;
+		}
+		while (!ifNoneMatch.empty()) {
+			const auto separator = std::min(
+				ifNoneMatch.find(','),
+				ifNoneMatch.size());
+			auto tag = Trimmed(ifNoneMatch.substr(0, separator));
+			ifNoneMatch.remove_prefix(
+				std::min(separator + 1, ifNoneMatch.size()));
+			if (tag.starts_with("W/")) {
+				tag.remove_prefix(2);
+			}
+			if (tag.size() < etag.size() + 2
+				|| tag.front() != '"'
+				|| tag.back() != '"') {
+				continue;
+			}
+			tag = tag.substr(1, tag.size() - 2);
+			if (tag == etag) {
+				return true;
+			} else if (tag.size() > etag.size() + 1
+				&& tag.starts_with(etag)
+				&& tag[etag.size()] == '-') {
+				// The same version sent with a Content-Encoding.
+				if (encoding) {
+					*encoding = tag.substr(etag.size() + 1);
+				}
 				return true;
 			}
 		}
 		return false;
-	}();
+	}
+	if (!ifModifiedSince.empty() && freshness.lastModified > 0) {
+		const auto since = ParseHttpDate(Trimmed(ifModifiedSince));
+		return (since > 0) && (freshness.lastModified <= since);
+	}
+	return false;
+}
+
+struct HttpServer::Private {
+	struct Connection {
+		QTcpSocket *socket = nullptr;
+		std::array<char, kMaxRequestHeadSize> buffer;
+		int size = 0;
+		int scanned = 0;
+		QByteArray route;
+		bool busy = false;
+		bool close = false;
+	};
+	struct Route {
+		QByteArray secret;
+		QByteArray authorization;
+		QByteArray redirectHost;
+		Handler handler;
+		std::unique_ptr<QTcpServer> listener;
+	};
+
+	[[nodiscard]] const Route *findRoute(
+		const QByteArray &secret,
+		std::string_view &id,
+		const HttpRequest &request) const;
+	void accept(QTcpServer *listener, const QByteArray &secret);
+
+	void readRequests(const std::shared_ptr<Connection> &connection);
+	void handleRequest(
+		const std::shared_ptr<Connection> &connection,
+		std::string_view head);
+	void finishRequest(
+		const std::shared_ptr<Connection> &connection,
+		bool completed);
+
+	bool processRedirect(
+		QTcpSocket *socket,
+		const QByteArray &redirectHost,
+		std::string_view id,
+		const HttpRequest &request,
+		const std::shared_ptr<Guard> &guard);
+
+	QObject *owner = nullptr;
+	QNetworkAccessManager manager;
+	std::vector<Route> routes;
+	std::vector<std::shared_ptr<Connection>> connections;
+};
+
+std::unique_ptr<DataStream> ByteRangesStream(
+		DataResponse &response,
+		const std::vector<DataRange> &ranges) {
+	if (!response.stream) {
+		return nullptr;
+	}
+	const auto from = response.streamOffset;
+	const auto till = from + response.stream->size();
+	const auto total = response.totalSize ? response.totalSize : till;
+	auto resolved = std::vector<DataRange>();
+	resolved.reserve(ranges.size());
+	for (const auto &range : ranges) {
+		const auto end = (range.limit > 0)
+			? std::min(range.offset + range.limit, total)
+			: total;
+		if (range.offset < from || range.offset >= end || end > till) {
+			return nullptr;
+		}
+		resolved.push_back({ range.offset, end - range.offset });
+	}
+	return std::make_unique<ByteRanges>(
+		std::move(response.stream),
+		from,
+		total,
+		resolved);
+}
+
+std::optional<DataEncodedStream> NegotiateEncoding(
+		DataResponse &response,
+		std::string_view acceptEncoding,
+		std::int64_t compressThreshold) {
+	if (!response.stream || response.streamOffset != 0) {
+		return std::nullopt;
+	}
+	const auto size = response.stream->size();
+	if (response.totalSize && response.totalSize != size) {
+		return std::nullopt;
+	}
+	for (auto &encoded : response.encoded) {
+		if (encoded.stream
+			&& !encoded.encoding.empty()
+			&& AcceptsEncoding(acceptEncoding, encoded.encoding)) {
+			return std::move(encoded);
+		}
+	}
+	if (compressThreshold <= 0
+		|| size < compressThreshold
+		|| size > kCompressSizeLimit
+		|| !Compressible(response.stream->mime())
+		|| !AcceptsEncoding(acceptEncoding, "deflate")) {
+		return std::nullopt;
+	}
+	auto deflated = Deflated(*response.stream, size);
+	if (!deflated) {
+		return std::nullopt;
+	}
+	return DataEncodedStream{
+		.encoding = "deflate",
+		.stream = std::move(deflated),
+	};
+}
 
-	if (!authed) {
+HttpServer::Guard::Guard(Fn<void(bool completed)> callback)
+: _callback(std::move(callback)) {
+}
+
+HttpServer::Guard::~Guard() {
+	if (_callback) {
+		_callback(_completed);
+	}
+}
+
+void HttpServer::Guard::complete() {
+	_completed = true;
+}
+
+void HttpServer::Private::readRequests(
+		const std::shared_ptr<Connection> &connection) {
+	const auto socket = connection->socket;
+	auto &buffer = connection->buffer;
+	while (!connection->busy
+		&& socket->state() == QAbstractSocket::ConnectedState) {
+		const auto capacity = int(buffer.size()) - connection->size;
+		if (capacity > 0) {
+			const auto read = socket->read(
+				buffer.data() + connection->size,
+				capacity);
+			if (read > 0) {
+				connection->size += int(read);
+			}
+		}
+		const auto received = std::string_view(
+			buffer.data(),
+			connection->size);
+		const auto headSize = FindRequestHeadEnd(
+			received,
+			connection->scanned);
+		if (!headSize) {
+			if (connection->size == int(buffer.size())) {
+				socket->disconnectFromHost();
+			}
+			return;
+		}
+		connection->busy = true;
+		handleRequest(connection, received.substr(0, headSize));
+
+		connection->size -= headSize;
+		connection->scanned = 0;
+		std::memmove(
+			buffer.data(),
+			buffer.data() + headSize,
+			connection->size);
+	}
+}
+
+void HttpServer::Private::finishRequest(
+		const std::shared_ptr<Connection> &connection,
+		bool completed) {
+	if (!completed || connection->close) {
+		connection->socket->disconnectFromHost();
+		return;
+	}
+	connection->busy = false;
+	readRequests(connection);
+}
+
+void HttpServer::Private::handleRequest(
+		const std::shared_ptr<Connection> &connection,
+		std::string_view head) {
+	const auto socket = connection->socket;
+	const auto guard = std::make_shared<Guard>(crl::guard(socket, [=](
+			bool completed) {
+		QMetaObject::invokeMethod(socket, [=] {
+			finishRequest(connection, completed);
+		}, Qt::QueuedConnection);
+	}));
+
+	auto request = HttpRequest();
+	if (!ParseRequestHead(head, request) || request.method != "GET") {
+		return;
+	}
+
+	if (request.version != "HTTP/1.1"
+		|| EqualsIgnoreCase(request.header("Connection"), "close")) {
+		connection->close = true;
+	}
+
+	auto id = request.target.substr(1);
+	const auto route = findRoute(connection->route, id, request);
+	if (!route) {
 		socket->write("HTTP/1.1 401 Unauthorized\r\n");
 		socket->write("WWW-Authenticate: Basic realm=\"\"\r\n");
+		socket->write("Content-Length: 0\r\n");
 		socket->write("\r\n");
+		guard->complete();
 		return;
 	}
 
-	const auto id = firstLine[1].mid(1);
-	if (processRedirect(socket, id, headers, guard) || !handler) {
+	if (processRedirect(socket, route->redirectHost, id, request, guard)
+		|| !route->handler) {
 		return;
 	}
 
-	handler(socket, id, headers, guard);
+	// The handler may remove its own route while being called.
+	const auto handler = route->handler;
+	handler(socket, id, request, guard);
+}
+
+// Only the route of the listener that accepted the connection is checked.
+// Removes the secret from the id, if the route was found by it.
+auto HttpServer::Private::findRoute(
+		const QByteArray &secret,
+		std::string_view &id,
+		const HttpRequest &request) const -> const Route* {
+	const auto i = std::ranges::find(routes, secret, &Route::secret);
+	if (i == end(routes)) {
+		return nullptr;
+	}
+	const auto slash = id.find('/');
+	if (slash != id.npos
+		&& ConstantTimeEquals(
+			id.substr(0, slash),
+			std::string_view(secret.constData(), secret.size()))) {
+		id.remove_prefix(slash + 1);
+		return &*i;
+	}
+	const auto &expected = i->authorization;
+	return ConstantTimeEquals(
+		request.header("Authorization"),
+		std::string_view(expected.constData(), expected.size()))
+		? &*i
+		: nullptr;
+}
+
+void HttpServer::Private::accept(
+		QTcpServer *listener,
+		const QByteArray &secret) {
+	while (const auto socket = listener->nextPendingConnection()) {
+		const auto connection = std::make_shared<Connection>();
+		connection->socket = socket;
+		connection->route = secret;
+		connections.push_back(connection);
+
+		QObject::connect(
+			socket,
+			&QAbstractSocket::disconnected,
+			socket,
+			&QObject::deleteLater);
+		QObject::connect(socket, &QObject::destroyed, owner, [=] {
+			connections.erase(std::ranges::find(connections, connection));
+		});
+
+		QObject::connect(socket, &QIODevice::readyRead, owner, [=] {
+			readRequests(connection);
+		});
+	}
 }
 
 bool HttpServer::Private::processRedirect(
 		QTcpSocket *socket,
-		const QByteArray &id,
-		const ::base::flat_map<QByteArray, QByteArray> &headers,
+		const QByteArray &redirectHost,
+		std::string_view id,
+		const HttpRequest &request,
 		const std::shared_ptr<Guard> &guard) {
-	const auto slash = id.indexOf('/');
+	const auto slash = id.find('/');
 	if (redirectHost.isEmpty()
-		|| slash <= 0
-		|| id.first(slash).compare(redirectHost, Qt::CaseInsensitive)) {
+		|| slash == id.npos
+		|| !slash
+		|| !EqualsIgnoreCase(
+			id.substr(0, slash),
+			std::string_view(redirectHost.constData(), redirectHost.size()))) {
 		return false;
 	}
 
 	const auto url = QUrl(
-		QString::fromUtf8("https://" + id),
+		u"https://"_q + QString::fromUtf8(id.data(), id.size()),
 		QUrl::StrictMode);
 	if (!url.isValid()
 		|| url.scheme().compare(u"https"_q, Qt::CaseInsensitive)
@@ -123,90 +798,337 @@ bool HttpServer::Private::processRedirect(
 		return false;
 	}
 
-	auto request = QNetworkRequest();
-	request.setUrl(url);
-	request.setAttribute(
+	auto outgoing = QNetworkRequest();
+	outgoing.setUrl(url);
+	outgoing.setAttribute(
 		QNetworkRequest::RedirectPolicyAttribute,
 		QNetworkRequest::SameOriginRedirectPolicy);
 
-	if (!headers.empty()) {
-		const auto headersToCopy = {
-			"Accept",
-			"User-Agent",
-			"Accept-Language",
-			"Accept-Encoding",
-		};
-		for (const auto name : headersToCopy) {
-			const auto it = headers.find(name);
-			if (it == headers.end()) {
-				continue;
-			}
-			request.setRawHeader(name, it->second.constData());
+	const auto headersToCopy = {
+		"Accept",
+		"User-Agent",
+		"Accept-Language",
+		"Accept-Encoding",
+		"Range",
+		"If-Range",
+		"If-None-Match",
+		"If-Modified-Since",
+	};
+	for (const auto name : headersToCopy) {
+		const auto value = request.header(name);
+		if (value.empty()) {
+			continue;
 		}
+		outgoing.setRawHeader(name, QByteArray(value.data(), value.size()));
+	}
+
+	// Otherwise Qt asks for compression itself and decompresses the body,
+	// so it wouldn't match the Content-Length we pass through.
+	if (request.header("Accept-Encoding").empty()) {
+		outgoing.setRawHeader("Accept-Encoding", "identity");
+	}
+
+	// The disk cache doesn't keep partial responses.
+	if (!request.header("Range").empty()) {
+		outgoing.setAttribute(
+			QNetworkRequest::CacheLoadControlAttribute,
+			QNetworkRequest::AlwaysNetwork);
+		outgoing.setAttribute(
+			QNetworkRequest::CacheSaveControlAttribute,
+			false);
 	}
 
 	// Always set our own Referer
-	request.setRawHeader("Referer", "http://desktop-app-resource/page.html");
+	outgoing.setRawHeader("Referer", "http://desktop-app-resource/page.html");
 
-	const auto reply = manager.get(request);
+	const auto reply = manager.get(outgoing);
+	reply->setReadBufferSize(kSocketBufferLimit);
 	connect(socket, &QObject::destroyed, reply, &QObject::deleteLater);
-	connect(reply, &QNetworkReply::finished, socket, [=] {
-		(void) guard;
-		const auto input = reply->readAll();
-		socket->write("HTTP/1.1 200 OK\r\n");
-		const auto headersToCopy = {
-			"Content-Type",
-			"Content-Encoding",
-			"Content-Length",
-		};
-		for (const auto name : headersToCopy) {
-			if (!reply->hasRawHeader(name)) {
-				continue;
+
+	// The body is written as it arrives, reading more of it only when the
+	// socket has drained what was written before.
+	struct State {
+		bool headWritten = false;
+		bool sized = false;
+		bool finished = false;
+	};
+	const auto state = std::make_shared<State>();
+	const auto pump = [=] {
+		if (state->finished) {
+			return;
+		} else if (!state->headWritten) {
+			const auto status = reply->attribute(
+				QNetworkRequest::HttpStatusCodeAttribute);
+			if (!status.isValid()) {
+				if (reply->isFinished()) {
+					state->finished = true;
+					reply->deleteLater();
+					socket->write("HTTP/1.1 502 Bad Gateway\r\n");
+					socket->write("Content-Length: 0\r\n");
+					socket->write("\r\n");
+					guard->complete();
+				}
+				return;
 			}
-			socket->write(
-				std::format(
-					"{}: {}\r\n",
-					name,
-					reply->rawHeader(name).toStdString()
-				).c_str()
-			);
-		}
-		socket->write("Cache-Control: no-store\r\n");
-		socket->write("\r\n");
-		socket->write(input);
-	}, Qt::SingleShotConnection);
+			state->headWritten = true;
+			const auto code = status.toInt();
+			const auto bodyless = (code == 204 || code == 304);
+			state->sized = bodyless || reply->hasRawHeader("Content-Length");
+			const auto reason = reply->attribute(
+				QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+			socket->write("HTTP/1.1 "
+				+ QByteArray::number(code)
+				+ ' '
+				+ (reason.isEmpty() ? QByteArray("OK") : reason)
+				+ "\r\n");
+			const auto headersToCopy = {
+				"Content-Type",
+				"Content-Encoding",
+				"Content-Length",
+				"Content-Range",
+				"Accept-Ranges",
+				"Cache-Control",
+				"Expires",
+				"ETag",
+				"Last-Modified",
+				"Vary",
+			};
+			for (const auto name : headersToCopy) {
+				if (!reply->hasRawHeader(name)) {
+					continue;
+				}
+				socket->write(
+					std::format(
+						"{}: {}\r\n",
+						name,
+						reply->rawHeader(name).toStdString()
+					).c_str()
+				);
+			}
+			if (!state->sized) {
+				// Without a length the end of the body is the end of the
+				// connection, the guard isn't completed for that.
+				socket->write("Connection: close\r\n");
+			}
+			socket->write("\r\n");
+		}
+		while (socket->bytesToWrite() < kSocketBufferLimit) {
+			const auto bytes = reply->read(kStreamSliceSize);
+			if (bytes.isEmpty()) {
+				break;
+			}
+			socket->write(bytes);
+		}
+		if (reply->isFinished() && !reply->bytesAvailable()) {
+			// Errors below the content ones mean the body was cut short,
+			// while the HTTP ones like 404 still have it complete.
+			const auto error = reply->error();
+			const auto failed = (error != QNetworkReply::NoError)
+				&& (error < QNetworkReply::ContentAccessDenied);
+			state->finished = true;
+			reply->deleteLater();
+			if (state->sized && !failed) {
+				guard->complete();
+			} else {
+				socket->disconnectFromHost();
+			}
+		}
+	};
+	connect(reply, &QNetworkReply::metaDataChanged, socket, pump);
+	connect(reply, &QIODevice::readyRead, socket, pump);
+	connect(reply, &QNetworkReply::finished, socket, pump);
+	connect(socket, &QIODevice::bytesWritten, reply, pump);
 
 	return true;
 }
 
-HttpServer::HttpServer(
+HttpServer::HttpServer()
+: _private(std::make_unique<Private>()) {
+	_private->owner = this;
+}
+
+HttpServer::~HttpServer() {
+	while (!_private->routes.empty()) {
+		removeRoute(_private->routes.back().secret);
+	}
+}
+
+void HttpServer::setRedirectCache(const QString &path, std::int64_t limit) {
+	if (_private->manager.cache() || path.isEmpty() || limit <= 0) {
+		return;
+	}
+	const auto cache = new QNetworkDiskCache(&_private->manager);
+	cache->setCacheDirectory(path);
+	cache->setMaximumCacheSize(limit);
+	_private->manager.setCache(cache);
+}
+
+void HttpServer::addRoute(
 		const QByteArray &password,
 		const QByteArray &redirectHost,
-		const std::function<void(
-			QTcpSocket *socket,
-			const QByteArray &id,
-			const ::base::flat_map<QByteArray, QByteArray> &headers,
-			const std::shared_ptr<Guard> &guard)> &handler)
-: _private(std::make_unique<Private>()) {
-	_private->password = password;
-	_private->redirectHost = redirectHost;
-	_private->handler = handler;
-
-	connect(this, &QTcpServer::newConnection, [=] {
-		while (const auto socket = nextPendingConnection()) {
-			connect(
-				socket,
-				&QAbstractSocket::disconnected,
-				socket,
-				&QObject::deleteLater);
-
-			connect(socket, &QIODevice::readyRead, this, [=] {
-				_private->handleRequest(socket);
-			}, Qt::SingleShotConnection);
-		}
+		Handler handler,
+		std::unique_ptr<QTcpServer> listener) {
+	removeRoute(password);
+	const auto raw = listener.get();
+	connect(raw, &QTcpServer::newConnection, this, [=] {
+		_private->accept(raw, password);
 	});
+	_private->routes.push_back({
+		.secret = password,
+		.authorization = "Basic " + (':' + password).toBase64(),
+		.redirectHost = redirectHost,
+		.handler = std::move(handler),
+		.listener = std::move(listener),
+	});
+
+	// Connections may have come before the route was added.
+	_private->accept(raw, password);
 }
 
-HttpServer::~HttpServer() = default;
+void HttpServer::removeRoute(const QByteArray &password) {
+	const auto i = std::ranges::find(
+		_private->routes,
+		password,
+		&Private::Route::secret);
+	if (i == end(_private->routes)) {
+		return;
+	}
+	// Accepted sockets are children of the listener and a handler may be
+	// on the stack for one of them, so both are destroyed later.
+	i->listener.release()->deleteLater();
+	_private->routes.erase(i);
+
+	auto serving = std::vector<QTcpSocket*>();
+	for (const auto &connection : _private->connections) {
+		if (connection->route == password) {
+			serving.push_back(connection->socket);
+		}
+	}
+	for (const auto socket : serving) {
+		socket->abort();
+		socket->deleteLater();
+	}
+}
+
+void SendStream(
+		QTcpSocket *socket,
+		std::unique_ptr<DataStream> stream,
+		std::int64_t size,
+		Fn<void(bool)> done,
+		std::shared_ptr<DataMetricsTrace> trace) {
+	struct State {
+		QPointer<QTcpSocket> socket;
+		std::unique_ptr<DataStream> stream;
+		DataStreamFromFile *file = nullptr;
+		DataStreamFromMappedFile *mapped = nullptr;
+		std::int64_t left = 0;
+		QMetaObject::Connection written;
+		Fn<void(bool)> done;
+		std::shared_ptr<DataMetricsTrace> trace;
+		bool reading = false;
+		bool pumping = false;
+	};
+	const auto state = std::make_shared<State>(State{
+		.socket = socket,
+		.stream = std::move(stream),
+		.left = size,
+		.done = std::move(done),
+		.trace = std::move(trace),
+	});
+	const auto raw = state->stream.get();
+	if (socket->socketDescriptor() >= 0) {
+		if (const auto file = dynamic_cast<DataStreamFromFile*>(raw)) {
+			state->file = (file->handle() >= 0) ? file : nullptr;
+		} else if (const auto mapped
+				= dynamic_cast<DataStreamFromMappedFile*>(raw)) {
+			state->mapped = mapped->valid() ? mapped : nullptr;
+		}
+	}
+
+	static constexpr auto finish = [](State *state, bool success) {
+		QObject::disconnect(state->written);
+		state->file = nullptr;
+		state->mapped = nullptr;
+		state->stream = nullptr;
+		state->trace = nullptr;
+		if (const auto done = ::base::take(state->done)) {
+			done(success);
+		}
+	};
+	static constexpr auto pump = [](
+			const std::shared_ptr<State> &state,
+			auto &&self) -> void {
+		const auto socket = state->socket.data();
+		const auto direct = [&] {
+			return state->file || state->mapped;
+		};
+		state->pumping = true;
+		while (socket && state->stream && !state->reading && state->left > 0) {
+			// Bytes sent directly must not overtake the ones Qt buffered.
+			const auto pending = socket->bytesToWrite();
+			if (pending >= kSocketBufferLimit || (direct() && pending)) {
+				if (state->trace && pending >= kSocketBufferLimit) {
+					state->trace->stalled();
+				}
+				break;
+			} else if (direct()) {
+				const auto descriptor = socket->socketDescriptor();
+				const auto sent = state->file
+					? SendFile(descriptor, state->file, state->left)
+					: SendMapped(descriptor, state->mapped, state->left);
+				if (sent < 0) {
+					finish(state.get(), false);
+					break;
+				} else if (sent > 0) {
+					state->left -= sent;
+					if (state->trace) {
+						state->trace->sent(sent);
+					}
+					continue;
+				} else if (state->trace) {
+					state->trace->stalled();
+				}
+				// The socket is full, buffer one slice in Qt so that we
+				// get bytesWritten when the socket is writable again.
+			}
+			// The chunk is borrowed, Qt copies it into the socket buffer,
+			// so nothing is copied twice. If the stream produces the chunk
+			// asynchronously the pumping continues from the callback.
+			const auto slice = std::min(state->left, kStreamSliceSize);
+			const auto weak = std::weak_ptr<State>(state);
+			state->reading = true;
+			state->stream->next(slice, [=](DataChunk chunk) {
+				const auto strong = weak.lock();
+				if (!strong || !strong->reading) {
+					return;
+				}
+				strong->reading = false;
+				if (!strong->socket || chunk.size <= 0) {
+					finish(strong.get(), false);
+					return;
+				}
+				const auto size = std::min(chunk.size, strong->left);
+				strong->socket->write(chunk.bytes, size);
+				strong->left -= size;
+				if (strong->trace) {
+					strong->trace->sent(size);
+				}
+				if (!strong->pumping) {
+					self(strong, self);
+				}
+			});
+		}
+		state->pumping = false;
+		if (state->stream && !state->reading && !state->left) {
+			finish(state.get(), true);
+		}
+	};
+	state->written = QObject::connect(
+		socket,
+		&QIODevice::bytesWritten,
+		socket,
+		[=] { pump(state, pump); });
+	pump(state, pump);
+}
 
 } // namespace Webview
@@ -6,32 +6,151 @@
 //
 #pragma once
 
-#include "base/flat_map.h"
+#include "base/basic_types.h"
 
-#include <QtNetwork/QTcpServer>
+#include <QtCore/QObject>
 
-#include <gsl/gsl>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class QHostAddress;
+class QTcpServer;
+class QTcpSocket;
 
 namespace Webview {
 
-class HttpServer : public QTcpServer {
+class DataStream;
+struct DataEncodedStream;
+struct DataFreshness;
+class DataMetricsTrace;
+struct DataRange;
+struct DataResponse;
+
+// Request head parsed in place, all the views point into the connection
+// buffer and are valid only while the request handler is being called.
+struct HttpRequest {
+	static constexpr auto kMaxHeaders = 32;
+
+	struct Header {
+		std::string_view name;
+		std::string_view value;
+	};
+
+	std::string_view method;
+	std::string_view target;
+	std::string_view version;
+	std::array<Header, kMaxHeaders> headers;
+	int headersCount = 0;
+
+	// Header names are compared case-insensitively.
+	[[nodiscard]] std::string_view header(std::string_view name) const;
+};
+
+// Each route is served by a listener of its own, on a loopback address
+// no other route uses, so that pages of different routes never share an
+// origin: neither storage and cookies nor the Basic auth protection space.
+//
+// Requests are checked by the password as the first path segment, so
+// that a new connection doesn't start with a 401 challenge round-trip.
+// Basic auth with the password is accepted as well, for URLs resolved
+// against the root, like "/favicon.ico", that lose the first segment.
+class HttpServer final : public QObject {
 public:
-	using Guard = gsl::final_action<std::function<void()>>;
+	// Keeps the request alive while its response is being written.
+	// The connection is reused for the next request only if complete()
+	// was called before the last copy is destroyed, otherwise it's closed.
+	class Guard final {
+	public:
+		explicit Guard(Fn<void(bool completed)> callback);
+		~Guard();
+
+		void complete();
+
+	private:
+		Fn<void(bool)> _callback;
+		bool _completed = false;
+
+	};
 
-	HttpServer(
+	using Handler = std::function<void(
+		QTcpSocket *socket,
+		std::string_view id,
+		const HttpRequest &request,
+		const std::shared_ptr<Guard> &guard)>;
+
+	struct Endpoint {
+		std::string host;
+		std::uint16_t port = 0;
+	};
+
+	HttpServer();
+	~HttpServer();
+
+	// The listener comes from ListenLoopback(), already listening.
+	// Sockets of a removed route are aborted, so that nothing the handler
+	// left pending for them gets written, and are destroyed later.
+	void addRoute(
 		const QByteArray &password,
 		const QByteArray &redirectHost,
-		const std::function<void(
-			QTcpSocket *socket,
-			const QByteArray &id,
-			const ::base::flat_map<QByteArray, QByteArray> &headers,
-			const std::shared_ptr<Guard> &guard)> &handler);
+		Handler handler,
+		std::unique_ptr<QTcpServer> listener);
+	void removeRoute(const QByteArray &password);
 
-	~HttpServer();
+	// Responses proxied to the redirect hosts are kept on disk, the first
+	// route asking for it chooses where and how much.
+	void setRedirectCache(const QString &path, std::int64_t limit);
 
 private:
 	struct Private;
 	const std::unique_ptr<Private> _private;
 };
 
+// Listener on one of 127.0.0.2 - 127.0.0.254 that isn't `taken`, tried in
+// turn starting from `next`, so that the address a removed route used gets
+// to a new route only after all the others did. nullptr if all are taken.
+[[nodiscard]] std::unique_ptr<QTcpServer> ListenLoopback(
+	int &next,
+	Fn<bool(const QHostAddress &)> taken);
+
+// ETag, Last-Modified and Cache-Control header lines for a response.
+// A body sent with a Content-Encoding gets its own "<etag>-<encoding>".
+[[nodiscard]] QByteArray FreshnessHeaders(
+	const DataFreshness &freshness,
+	std::string_view encoding = {});
+
+// Whether If-None-Match / If-Modified-Since allow answering with 304,
+// `encoding` receives the one of the matched entity tag, if any.
+[[nodiscard]] bool NotModified(
+	const DataFreshness &freshness,
+	std::string_view ifNoneMatch,
+	std::string_view ifModifiedSince,
+	std::string_view *encoding = nullptr);
+
+// Body of a multipart/byteranges response with all of the ranges taken
+// from the response stream, nullptr if it doesn't contain all of them.
+[[nodiscard]] std::unique_ptr<DataStream> ByteRangesStream(
+	DataResponse &response,
+	const std::vector<DataRange> &ranges);
+
+// Whole response body in one of the encodings the client accepts, either
+// a precompressed one or, for text of at least `compressThreshold` bytes,
+// the stream deflated right away. std::nullopt keeps the identity body.
+[[nodiscard]] std::optional<DataEncodedStream> NegotiateEncoding(
+	DataResponse &response,
+	std::string_view acceptEncoding,
+	std::int64_t compressThreshold);
+
+// Writes `size` bytes of the stream, starting from its current position,
+// reading the next slice only when the socket drained the previous ones.
+// This way the memory used per connection doesn't depend on `size`.
+void SendStream(
+	QTcpSocket *socket,
+	std::unique_ptr<DataStream> stream,
+	std::int64_t size,
+	Fn<void(bool)> done,
+	std::shared_ptr<DataMetricsTrace> trace = nullptr);
+
 } // namespace Webview
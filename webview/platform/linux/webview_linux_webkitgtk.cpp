@@ -8,11 +8,16 @@
 
 #include "webview/platform/linux/webview_linux_webkitgtk_library.h"
 #include "webview/platform/linux/webview_linux_compositor.h"
+#include "webview/platform/linux/webview_linux_data_server.h"
 #include "webview/platform/linux/webview_linux_http_server.h"
+#include "webview/webview_data_cache.h"
+#include "webview/webview_data_metrics.h"
+#include "webview/webview_data_single_flight.h"
 #include "webview/webview_data_stream.h"
 #include "base/platform/base_platform_info.h"
 #include "base/platform/linux/base_linux_xdg_activation_token.h"
 #include "base/algorithm.h"
+#include "base/flat_map.h"
 #include "base/debug_log.h"
 #include "base/integration.h"
 #include "base/random.h"
@@ -21,9 +26,12 @@
 #include "base/event_filter.h"
 #include "ui/gl/gl_detection.h"
 
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
 #include <QtCore/QUrl>
 #include <QtNetwork/QTcpSocket>
 #include <QtGui/QDesktopServices>
@@ -36,6 +44,7 @@
 #include <array>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <vector>
 #ifdef DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
 #include <QtQuickWidgets/QQuickWidget>
@@ -66,7 +75,8 @@ constexpr auto kMasterObjectPath
 	= "/org/desktop_app/GtkIntegration/Webview/Master";
 constexpr auto kHelperObjectPath
 	= "/org/desktop_app/GtkIntegration/Webview/Helper";
-constexpr auto kDataHost = "127.0.0.1";
+constexpr auto kDataScheme = "desktopappresource";
+constexpr auto kDataTransferChunk = std::int64_t(256 * 1024);
 constexpr auto kExternalShellFallbackBackground = "#eeeeee";
 constexpr auto kMaxScriptMessageBytes = 2 * 1024 * 1024;
 constexpr auto kExternalMessageType = "tdesktop_external_bot_webapp";
@@ -207,10 +217,107 @@ inline auto MethodError() {
 		"Method does not exist.");
 }
 
+// Data chunks are binary, so they are passed as a GVariant with a size
+// and not as a bytestring that ends at the first zero byte.
+[[nodiscard]] GLib::Variant BytesToVariant(std::string_view bytes) {
+	return gi::wrap(
+		g_variant_ref_sink(g_variant_new_fixed_array(
+			G_VARIANT_TYPE_BYTE,
+			bytes.data(),
+			bytes.size(),
+			1)),
+		gi::transfer_full);
+}
+
+[[nodiscard]] std::string VariantToBytes(GLib::Variant variant) {
+	auto size = gsize();
+	const auto data = g_variant_get_fixed_array(variant.gobj_(), &size, 1);
+	return size
+		? std::string(static_cast<const char*>(data), size)
+		: std::string();
+}
+
+[[nodiscard]] GLib::Variant StringsToVariant(
+		const std::vector<std::string> &strings) {
+	auto pointers = std::vector<const gchar*>();
+	pointers.reserve(strings.size());
+	for (const auto &string : strings) {
+		pointers.push_back(string.c_str());
+	}
+	return gi::wrap(
+		g_variant_ref_sink(g_variant_new_strv(
+			pointers.data(),
+			pointers.size())),
+		gi::transfer_full);
+}
+
+[[nodiscard]] std::vector<std::string> VariantToStrings(
+		GLib::Variant variant) {
+	auto size = gsize();
+	const auto strings = g_variant_get_strv(variant.gobj_(), &size);
+	auto result = std::vector<std::string>();
+	result.reserve(size);
+	for (auto i = gsize(); i != size; ++i) {
+		result.emplace_back(strings[i]);
+	}
+	g_free(strings);
+	return result;
+}
+
 inline std::string SocketPathToDBusAddress(const std::string &socketPath) {
 	return "unix:path=" + Gio::dbus_address_escape_value(socketPath);
 }
 
+enum class NavigationDecision {
+	Allow,
+	Block,
+	Ask,
+};
+
+// The policy is passed to the helper with the Create call, lowercased
+// there, so that the URLs are only lowercased once per decision.
+[[nodiscard]] NavigationPolicy ParseNavigationPolicy(
+		GLib::Variant allowedSchemes,
+		GLib::Variant allowedPrefixes) {
+	const auto list = [](GLib::Variant variant) {
+		auto result = VariantToStrings(variant);
+		for (auto &value : result) {
+			value = QString::fromStdString(value).toLower().toStdString();
+		}
+		return result;
+	};
+	return {
+		.allowedSchemes = list(allowedSchemes),
+		.allowedPrefixes = list(allowedPrefixes),
+	};
+}
+
+// Same as the master does, the data domain is always allowed.
+[[nodiscard]] NavigationDecision DecideNavigation(
+		const NavigationPolicy &policy,
+		const std::string &dataDomain,
+		const std::string &uri) {
+	if (uri.starts_with(dataDomain)) {
+		return NavigationDecision::Allow;
+	}
+	const auto lower = QString::fromStdString(uri).toLower().toStdString();
+	const auto colon = lower.find(':');
+	if (!policy.allowedSchemes.empty()
+		&& (colon == std::string::npos
+			|| std::ranges::find(
+				policy.allowedSchemes,
+				std::string_view(lower).substr(0, colon))
+					== end(policy.allowedSchemes))) {
+		return NavigationDecision::Block;
+	}
+	const auto prefixed = [&](const std::string &prefix) {
+		return MatchesNavigationPrefix(lower, prefix);
+	};
+	return std::ranges::any_of(policy.allowedPrefixes, prefixed)
+		? NavigationDecision::Allow
+		: NavigationDecision::Ask;
+}
+
 enum class ShellControlAction {
 	None,
 	BeginMove,
@@ -590,16 +697,331 @@ void SetFrameExtents(GtkWidget *window, const QMargins &margins) {
 	}
 }
 
+struct DataSlice {
+	std::int64_t length = 0; // Bytes to send from this stream.
+	std::int64_t limit = 0; // Bytes left in the whole requested range.
+	std::int64_t total = 0;
+	bool partial = false;
+};
+
+// Seeks the stream to the requested offset, std::nullopt if the response
+// doesn't contain it.
+[[nodiscard]] std::optional<DataSlice> PrepareDataSlice(
+		DataResponse &resolved,
+		std::int64_t requestedOffset,
+		std::int64_t requestedLimit) {
+	const auto &stream = resolved.stream;
+	if (!stream) {
+		return std::nullopt;
+	}
+	const auto length = stream->size();
+	Assert(length > 0);
+
+	const auto offset = resolved.streamOffset;
+	if (requestedOffset >= offset + length || offset > requestedOffset) {
+		return std::nullopt;
+	}
+
+	const auto useOffset = (requestedOffset - offset);
+	const auto useLength = (requestedLimit > 0)
+		? std::min(requestedLimit, (length - useOffset))
+		: (length - useOffset);
+	if (useOffset > 0 && stream->seek(SEEK_SET, useOffset) != useOffset) {
+		LOG(("WebView Error: Could not seek data stream."));
+		return std::nullopt;
+	}
+
+	const auto total = resolved.totalSize ? resolved.totalSize : length;
+	return DataSlice{
+		.length = useLength,
+		.limit = (requestedLimit > 0)
+			? requestedLimit
+			: (total - requestedOffset),
+		.total = total,
+		.partial = (requestedOffset > 0) || (requestedLimit > 0),
+	};
+}
+
+void FinishSchemeRequestNotFound(WebKitURISchemeRequest *request) {
+	const auto error = g_error_new_literal(
+		G_IO_ERROR,
+		G_IO_ERROR_NOT_FOUND,
+		"Not found.");
+	webkit_uri_scheme_request_finish_error(request, error);
+	g_error_free(error);
+}
+
+void WriteAllAsync(
+		GOutputStream *stream,
+		std::string bytes,
+		Fn<void(bool)> done) {
+	struct Write {
+		std::string bytes;
+		Fn<void(bool)> done;
+	};
+	const auto write = new Write{ std::move(bytes), std::move(done) };
+	g_output_stream_write_all_async(
+		stream,
+		write->bytes.data(),
+		write->bytes.size(),
+		G_PRIORITY_DEFAULT,
+		nullptr,
+		+[](GObject *source, GAsyncResult *result, gpointer data) {
+			const auto write = std::unique_ptr<Write>(
+				static_cast<Write*>(data));
+			write->done(g_output_stream_write_all_finish(
+				G_OUTPUT_STREAM(source),
+				result,
+				nullptr,
+				nullptr));
+		},
+		write);
+}
+
+[[nodiscard]] Platform DefaultPlatform([[maybe_unused]] WindowMode mode) {
+	return ::Platform::IsX11()
+		? Platform::X11
+#ifdef DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
+		: (mode == WindowMode::Embedded)
+		? Platform::Wayland
+#endif // DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
+		: Platform::Any;
+}
+
+// Helpers showing their own windows outside of X11 embedding get a fresh
+// activation token on launch and Wayland ones a compositor of their own,
+// so those can't be started in advance or handed to the next webview.
+[[nodiscard]] bool Poolable(Platform platform, WindowMode mode) {
+	return (mode == WindowMode::Hidden)
+		|| (platform == Platform::X11 && mode == WindowMode::Embedded);
+}
+
+// Same as for the pool, except that X11 external windows don't need an
+// activation token, so only the ones launched with it are left out.
+[[nodiscard]] bool Shareable(Platform platform, WindowMode mode) {
+	return (mode == WindowMode::Hidden) || (platform == Platform::X11);
+}
+
+// Key of the helper process the webview may be hosted in, if any.
+[[nodiscard]] std::optional<std::string> SharingGroup(const Config &config) {
+	if (config.helperSharing == HelperSharing::None
+		|| !config.restrictedOrigin.empty()
+		|| !Shareable(DefaultPlatform(config.mode), config.mode)) {
+		return std::nullopt;
+	}
+	return (config.helperSharing == HelperSharing::ByStorage)
+		? ("storage:" + config.userDataPath)
+		: std::string();
+}
+
+// The first view of a process lives on the default object paths.
+[[nodiscard]] std::string ViewObjectPath(
+		const char *path,
+		std::uint64_t id) {
+	return id
+		? (std::string(path) + '/' + std::to_string(id))
+		: std::string(path);
+}
+
+class Instance;
+
+// Views of this process with custom scheme data, the scheme handler is
+// registered once per context and finds the instance by the view.
+[[nodiscard]] ::base::flat_map<WebKitWebView*, Instance*> &SchemeViews() {
+	static auto result = ::base::flat_map<WebKitWebView*, Instance*>();
+	return result;
+}
+
+// Windows of the views in this helper process. A helper hosting several
+// views, or one reset to be pooled, must outlive any single one of them.
+[[nodiscard]] int &HelperWindows() {
+	static auto result = 0;
+	return result;
+}
+
+// Helper processes started and resolved in the background, as well as
+// the ones left by closed webviews after they were reset, so that a new
+// webview only has to wait for the helper to create the view itself.
+class HelperPool final {
+public:
+	~HelperPool();
+
+	[[nodiscard]] static HelperPool &Get();
+
+	void setSize(int size);
+
+	// Remembers the mode, so that the next ones are started for it.
+	[[nodiscard]] std::unique_ptr<Instance> take(WindowMode mode);
+
+	[[nodiscard]] bool wants(Platform platform, WindowMode mode) const;
+	void recycle(std::unique_ptr<Instance> instance);
+
+private:
+	struct Entry {
+		std::unique_ptr<Instance> instance;
+		std::uint64_t id = 0;
+		bool ready = false;
+	};
+
+	void refill();
+	void clear();
+	void watchQuit();
+	void prepare(
+		std::unique_ptr<Instance> instance,
+		Fn<void(Instance*, Fn<void(bool)>)> start);
+	void finished(std::uint64_t id, bool success);
+	[[nodiscard]] int count(WindowMode mode) const;
+
+	std::vector<Entry> _entries;
+	std::uint64_t _autoincrement = 0;
+	WindowMode _mode = WindowMode::Embedded;
+	int _size = 0;
+	bool _quitWatched = false;
+
+};
+
+// Master side of a helper process hosting the views of several instances,
+// alive while any of them is. The instance that started the process talks
+// to the helper object on the default path, the other ones ask the `host`
+// object for views of their own.
+struct SharedProcess {
+	~SharedProcess();
+
+	[[nodiscard]] static std::shared_ptr<SharedProcess> Find(
+		WindowMode mode,
+		const std::string &group);
+	static void Register(const std::shared_ptr<SharedProcess> &process);
+
+	Gio::Subprocess process;
+	Gio::DBusServer server;
+	Gio::DBusObjectManagerServer objectManager;
+	Gio::DBusConnection connection;
+	Helper host;
+	Platform platform = Platform::Any;
+	WindowMode mode = WindowMode::Embedded;
+	std::string group;
+	bool dataSchemeSupported = false;
+	std::string library;
+	std::uint64_t viewAutoincrement = 0;
+	bool connected = true;
+
+};
+
+// Serves an instance under its route of the data server. With the server
+// thread enabled the route is used there and doesn't touch the instance,
+// only the data requests are passed to main and the responses back. The
+// instance detaches it on main before releasing the server.
+class DataRoute final : public std::enable_shared_from_this<DataRoute> {
+public:
+	struct Descriptor {
+		QObject *context = nullptr; // Server thread, nullptr if on main.
+		DataMetricsCollector *metrics = nullptr; // Alive while routed.
+		int readAhead = 0;
+		std::int64_t compressThreshold = 0;
+		Fn<DataResult(DataRequest)> request; // Called on main.
+	};
+	explicit DataRoute(Descriptor &&descriptor);
+
+	void handle(
+		QTcpSocket *socket,
+		std::string_view id,
+		const HttpRequest &request,
+		const std::shared_ptr<HttpServer::Guard> &guard);
+
+	// Called on main, responses to the pending requests are dropped.
+	void detach();
+
+private:
+	// Continuation parts of a response, requested in advance and written
+	// in order of their offsets.
+	struct ReadAhead {
+		struct Part {
+			std::int64_t offset = 0;
+			std::int64_t limit = 0;
+			std::optional<DataResponse> response;
+		};
+		QTcpSocket *socket = nullptr;
+		std::string resourceId;
+		std::shared_ptr<HttpServer::Guard> guard;
+		std::shared_ptr<DataMetricsTrace> trace;
+		std::deque<Part> parts;
+		std::int64_t position = 0; // Next byte to write.
+		std::int64_t requested = 0; // Next byte to request.
+		std::int64_t till = 0;
+		std::int64_t partSize = 0;
+		bool writing = false;
+	};
+
+	void requestData(
+		DataRequest request,
+		Fn<void()> failed,
+		std::shared_ptr<DataMetricsTrace> trace = nullptr);
+	void respond(
+		DataResponse resolved,
+		QTcpSocket *socket,
+		const std::string &resourceId,
+		std::int64_t requestedOffset,
+		std::int64_t requestedLimit,
+		bool negotiable,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace);
+	bool respondRanges(
+		DataResponse &resolved,
+		QTcpSocket *socket,
+		const std::vector<DataRange> &ranges,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace);
+	bool respondEncoded(
+		DataResponse &resolved,
+		QTcpSocket *socket,
+		std::string_view acceptEncoding,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace);
+	void fillReadAhead(const std::shared_ptr<ReadAhead> &state);
+	void requestReadAheadPart(
+		const std::shared_ptr<ReadAhead> &state,
+		std::int64_t offset,
+		std::int64_t limit);
+	void writeReadAhead(const std::shared_ptr<ReadAhead> &state);
+
+	QObject * const _context = nullptr;
+	DataMetricsCollector * const _metrics = nullptr;
+	const int _readAhead = 0;
+	const std::int64_t _compressThreshold = 0;
+	Fn<DataResult(DataRequest)> _request;
+
+};
+
 class Instance final : public Interface, public ::base::has_weak_ptr {
 public:
 	Instance(
 		bool remoting = true,
-		WindowMode mode = WindowMode::Embedded);
+		WindowMode mode = WindowMode::Embedded,
+		bool startProcessNow = true);
 	~Instance();
 
 	bool create(Config config);
 	ResolveResult resolve();
+
+	// Don't spin the main loop while waiting for the helper process.
+	void startProcess(Fn<void()> finished);
+	void create(Config config, Fn<void(bool)> done);
+	void resolve(Fn<void(ResolveResult)> done);
+
+	// Reuses the helper process of the same sharing group, if any.
+	void startShared(std::string group, Fn<void()> finished);
+
+	// Pooled helpers, started in advance or reset after being used.
+	void warmUp(Fn<void(bool)> done);
+	void resetProcess(Fn<void(bool)> done);
+	[[nodiscard]] WindowMode mode() const;
+	[[nodiscard]] bool connected() const;
+
 	bool startDataServer();
+	void stopDataServer();
+	[[nodiscard]] bool dataSchemeSupported() const;
+	[[nodiscard]] Platform platform() const;
+	[[nodiscard]] const std::string &library() const;
 
 	void resize(int w, int h) override;
 
@@ -626,6 +1048,12 @@ public:
 
 	void setOpaqueBg(QColor opaqueBg) override;
 
+	DataCacheStats dataCacheStats() override;
+	void invalidateData(const std::string &id) override;
+	DataMetrics dataMetrics() override;
+	auto dataRequestMetrics()
+		-> rpl::producer<DataRequestMetrics> override;
+
 	int exec();
 
 private:
@@ -656,27 +1084,61 @@ private:
 		WebKitPolicyDecisionType decisionType);
 	GtkWidget *createAnother(WebKitNavigationAction *action);
 	bool scriptDialog(WebKitScriptDialog *dialog);
+	void scheduleNavigationDoneCheck();
 	void evalNow(std::string js);
 	void scheduleQueuedEvals();
 	bool authenticate(WebKitAuthenticationRequest *request);
 	bool permissionRequest(WebKitPermissionRequest *request);
 
 	std::string dataDomain();
-	void dataRequest(
-		DataResponse resolved,
-		QTcpSocket *socket,
+	DataResult requestData(DataRequest request);
+	void startDataTransfer(
+		Gio::DBusMethodInvocation invocation,
 		const std::string &resourceId,
+		DataResponse resolved,
 		std::int64_t requestedOffset,
-		std::int64_t requestedLimit,
-		bool headersWritten,
-		const std::shared_ptr<HttpServer::Guard> &guard);
+		std::int64_t requestedLimit);
+	void readDataTransfer(
+		Gio::DBusMethodInvocation invocation,
+		std::uint64_t id);
+	void dropDataTransfer(std::uint64_t id);
+	void dropDataTransfers();
+	void schemeRequest(WebKitURISchemeRequest *request);
+	void schemeRespond(
+		WebKitURISchemeRequest *request,
+		std::uint64_t transfer,
+		const std::string &mime,
+		bool partial,
+		std::int64_t start,
+		std::int64_t length,
+		std::int64_t total,
+		const std::string &headers);
+	void schemeRead(std::uint64_t transfer);
+	void schemeFinish(std::uint64_t transfer, bool cancel);
 
 	void startProcess();
 	void stopProcess();
+	void watchConnection();
+	[[nodiscard]] bool recycleProcess();
+	void adoptProcess(Instance &from);
+	void attachView(
+		std::shared_ptr<SharedProcess> process,
+		Fn<void()> finished);
+	void detachView();
+	void exportView(
+		Gio::DBusConnection connection,
+		Gio::DBusObjectManagerServer manager,
+		Platform platform,
+		std::uint64_t id,
+		Fn<void(bool)> done);
+	void destroyView();
+	void applyConfig(Config &config);
+	void createRemoteWidget(QWidget *parent);
 	void updateHistoryStates();
 
 	void registerMasterMethodHandlers();
 	void registerHelperMethodHandlers();
+	void registerHostMethodHandlers(Gio::DBusConnection connection);
 	void scheduleWaylandPopupAnchorExport();
 	void ensureWaylandPopupAnchorExport();
 	void clearWaylandPopupAnchorExport();
@@ -694,17 +1156,57 @@ private:
 	WindowMode _mode = WindowMode::Embedded;
 	WindowStyle _windowStyle = WindowStyle::Default;
 	bool _connected = false;
+	std::optional<ResolveResult> _resolved;
 	Master _master;
 	Helper _helper;
+	Gio::DBusConnection _connection;
+	ulong _connectionClosed = 0;
 	Gio::DBusServer _dbusServer;
 	Gio::DBusObjectManagerServer _dbusObjectManager;
 	Gio::Subprocess _serviceProcess;
+	std::shared_ptr<SharedProcess> _shared;
+	std::uint64_t _viewId = 0;
+
+	// Helper side, views of the instances sharing this process.
+	::base::flat_map<std::uint64_t, std::unique_ptr<Instance>> _views;
 
 	Platform _platform = Platform::Any;
 	Ui::GL::Backend _glBackend;
 	::base::unique_qptr<QWidget> _widget;
 	::base::unique_qptr<Compositor> _compositor;
-	std::optional<HttpServer> _dataServer;
+	std::shared_ptr<DataServer> _dataServer;
+	std::shared_ptr<DataRoute> _dataRoute;
+	std::optional<DataCache> _dataCache;
+	std::optional<DataSingleFlight> _dataSingleFlight;
+	std::unique_ptr<DataMetricsCollector> _dataMetrics;
+	bool _dataServerThreadEnabled = false;
+	int _dataReadAhead = 0;
+	std::int64_t _dataCompressThreshold = 0;
+	std::string _dataRedirectCachePath;
+	std::int64_t _dataRedirectCacheLimit = 0;
+
+	// Master side of the custom scheme, the stream being read by the helper.
+	struct DataTransfer {
+		std::string resourceId;
+		std::unique_ptr<DataStream> stream;
+		std::int64_t streamLeft = 0;
+		std::int64_t nextOffset = 0;
+		std::int64_t left = 0;
+		std::optional<Gio::DBusMethodInvocation> reading;
+	};
+	::base::flat_map<std::uint64_t, DataTransfer> _dataTransfers;
+	std::uint64_t _dataTransferAutoincrement = 0;
+
+	// Helper side, the pipe write ends WebKit reads the responses from.
+	struct SchemeTransfer {
+		GOutputStream *output = nullptr;
+		std::int64_t left = 0;
+	};
+	::base::flat_map<std::uint64_t, SchemeTransfer> _schemeTransfers;
+	bool _dataSchemeSupported = false;
+	std::string _library;
+	bool _dataScheme = false;
+	std::string _dataProtocol;
 
 	GtkWidget *_window = nullptr;
 	WebKitWebView *_webview = nullptr;
@@ -723,6 +1225,9 @@ private:
 	bool _debug = false;
 	std::function<void(Message)> _messageHandler;
 	std::function<bool(std::string,bool)> _navigationStartHandler;
+	NavigationPolicy _navigationPolicy;
+	std::uint64_t _navigationDoneCheckId = 0;
+	int _navigationAsksPending = 0;
 	std::function<void(bool)> _navigationDoneHandler;
 	std::function<void()> _externalWindowCloseHandler;
 	std::function<DialogResult(DialogArgs)> _dialogHandler;
@@ -732,6 +1237,7 @@ private:
 	Fn<void()> _interactionHandler;
 	std::string _dataRequestRedirectHost;
 	std::string _restrictedOrigin;
+	std::string _dataHost;
 	std::uint16_t _dataPort = 0;
 	std::string _dataPassword;
 	std::string _shellMessageToken;
@@ -744,30 +1250,39 @@ private:
 
 };
 
-Instance::Instance(bool remoting, WindowMode mode)
+Instance::Instance(bool remoting, WindowMode mode, bool startProcessNow)
 : _remoting(remoting)
 , _mode(mode) {
 	if (_remoting) {
-		_platform = ::Platform::IsX11()
-			? Platform::X11
-#ifdef DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
-			: (_mode == WindowMode::Embedded
-				? Platform::Wayland
-				: Platform::Any);
-#else // DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
-			: Platform::Any;
-#endif // !DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
+		_platform = DefaultPlatform(_mode);
 		_glBackend = Ui::GL::ChooseBackendDefault(Ui::GL::CheckCapabilities());
-		startProcess();
+		if (startProcessNow) {
+			startProcess();
+		}
 	}
 }
 
 Instance::~Instance() {
-	if (_remoting) {
+	stopDataServer();
+	if (_remoting && !recycleProcess()) {
 		stopProcess();
 	}
+	destroyView();
+}
+
+void Instance::destroyView() {
+	if (_webview) {
+		SchemeViews().remove(_webview);
+	}
+	for (const auto &[id, transfer] : ::base::take(_schemeTransfers)) {
+		g_object_unref(transfer.output);
+		if (_master) {
+			_master.call_data_cancel(id, nullptr);
+		}
+	}
+	dropDataTransfers();
 	if (_backgroundProvider) {
-		g_object_unref(_backgroundProvider);
+		g_object_unref(::base::take(_backgroundProvider));
 	}
 	if (_window) {
 		if (_frameExtentsToplevel && _frameExtentsComputeSizeHandler) {
@@ -775,18 +1290,50 @@ Instance::~Instance() {
 				_frameExtentsToplevel,
 				_frameExtentsComputeSizeHandler);
 		}
+		_frameExtentsToplevel = nullptr;
+		_frameExtentsComputeSizeHandler = 0;
 		clearWaylandPopupAnchorExport();
+
+		// The "destroy" handler would quit the whole helper process.
+		g_signal_handlers_disconnect_by_data(_window, this);
+		if (_webview) {
+			g_signal_handlers_disconnect_by_data(
+				webkit_web_view_get_user_content_manager(_webview),
+				this);
+			g_signal_handlers_disconnect_by_data(_webview, this);
+		}
+		--HelperWindows();
 		if (gtk_window_destroy) {
 			gtk_window_destroy(GTK_WINDOW(_window));
 		} else {
 			gtk_widget_destroy(_window);
 		}
-	}
+		_window = nullptr;
+		_webview = nullptr;
+	}
+	_restrictedOrigin.clear();
+	_shellMessageToken.clear();
+	_messageToken = GenerateMessageToken();
+	_dataHost.clear();
+	_dataPort = 0;
+	_dataPassword.clear();
+	_queuedScriptDialogEvals.clear();
+	_loadFailed = false;
+	_externalWindowCloseAllowed = false;
+	_externalWindowClosePending = false;
+	_fullscreen = false;
+	_windowSupportsAlpha = true;
 }
 
-bool Instance::create(Config config) {
-	if (_remoting) {
-		const auto resolveResult = resolve();
+void Instance::create(Config config, Fn<void(bool)> done) {
+	Expects(_remoting);
+
+	const auto parent = QPointer<QWidget>(config.parent);
+	const auto parentLost = [=, hadParent = (config.parent != nullptr)] {
+		return hadParent && !parent;
+	};
+	resolve([=, config = std::move(config)](
+			ResolveResult resolveResult) mutable {
 		if (resolveResult != ResolveResult::Success) {
 			LOG(("WebView Error: %1.").arg(
 				resolveResult == ResolveResult::NoLibrary
@@ -796,7 +1343,11 @@ bool Instance::create(Config config) {
 					: resolveResult == ResolveResult::IPCFailure
 					? "Inter-process communication failure"
 					: "Unknown error"));
-			return false;
+			done(false);
+			return;
+		} else if (parentLost()) {
+			done(false);
+			return;
 		}
 
 #ifdef DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
@@ -814,7 +1365,7 @@ bool Instance::create(Config config) {
 					}
 					return true;
 				}();
-				_widget = ::base::make_unique_q<QQuickWidget>(config.parent);
+				_widget = ::base::make_unique_q<QQuickWidget>(parent.data());
 				widget = static_cast<QQuickWidget*>(_widget.get());
 				_compositor->setWidget(widget);
 			}
@@ -830,33 +1381,26 @@ bool Instance::create(Config config) {
 		if (_compositor) {
 			_platform = Platform::Any;
 			stopProcess();
-			startProcess();
-			return create(std::move(config));
+			startProcess([=, config = std::move(config)]() mutable {
+				create(std::move(config), done);
+			});
+			return;
 		}
 #endif // !DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
-	}
-
-	_restrictedOrigin = std::move(config.restrictedOrigin);
-	_debug = config.debug && _restrictedOrigin.empty();
-	_messageHandler = std::move(config.messageHandler);
-	_navigationStartHandler = std::move(config.navigationStartHandler);
-	_navigationDoneHandler = std::move(config.navigationDoneHandler);
-	_externalWindowCloseHandler = std::move(config.externalWindowCloseHandler);
-	_dialogHandler = std::move(config.dialogHandler);
-	_asyncDialogHandler = std::move(config.asyncDialogHandler);
-	_dataRequestHandler = std::move(config.dataRequestHandler);
-	_dataRequestRedirectHost = std::move(config.dataRequestRedirectHost);
-	_windowStyle = config.windowStyle;
-	_windowMargins = config.windowMargins;
-	_shellMessageToken = std::move(config.shellMessageToken);
 
-	if (_remoting) {
+		applyConfig(config);
 		if (!_helper) {
-			return false;
+			done(false);
+			return;
 		}
 
-		const ::base::has_weak_ptr guard;
-		std::optional<bool> success;
+		// The redirect proxy lives in the loopback data server.
+		_dataScheme = _dataSchemeSupported
+			&& _dataRequestRedirectHost.empty();
+		_dataProtocol = config.dataProtocolOverride.empty()
+			? std::string(kDataScheme)
+			: std::move(config.dataProtocolOverride);
+
 		const auto debug = _debug;
 		const auto r = config.opaqueBg.red();
 		const auto g = config.opaqueBg.green();
@@ -870,6 +1414,11 @@ bool Instance::create(Config config) {
 		const auto initialSize = config.initialSize;
 		const auto allowThirdPartyCookies = config.allowThirdPartyCookies;
 		const auto restrictedOrigin = _restrictedOrigin;
+		const auto dataProtocol = _dataScheme ? _dataProtocol : std::string();
+		const auto allowedSchemes = StringsToVariant(
+			_navigationPolicy.allowedSchemes);
+		const auto allowedPrefixes = StringsToVariant(
+			_navigationPolicy.allowedPrefixes);
 		_helper.call_create(
 			debug,
 			r,
@@ -888,71 +1437,130 @@ bool Instance::create(Config config) {
 			initialSize.height(),
 			allowThirdPartyCookies,
 			restrictedOrigin,
-			crl::guard(&guard, [&](
+			dataProtocol,
+			allowedSchemes,
+			allowedPrefixes,
+			crl::guard(this, [=](
 					GObjectCpp::Object source_object,
 					Gio::AsyncResult res) {
-				success = _helper.call_create_finish(res, nullptr);
-				GLib::MainContext::default_().wakeup();
+				if (!_helper.call_create_finish(res, nullptr)
+						|| parentLost()) {
+					done(false);
+					return;
+				}
+				createRemoteWidget(parent.data());
+				done(true);
 			}));
+	});
+}
 
-		while (!success && _connected) {
-			GLib::MainContext::default_().iteration(true);
+void Instance::applyConfig(Config &config) {
+	_restrictedOrigin = std::move(config.restrictedOrigin);
+	_debug = config.debug && _restrictedOrigin.empty();
+	_messageHandler = std::move(config.messageHandler);
+	_navigationStartHandler = std::move(config.navigationStartHandler);
+	_navigationPolicy = std::move(config.navigationPolicy);
+	_navigationDoneHandler = std::move(config.navigationDoneHandler);
+	_externalWindowCloseHandler = std::move(config.externalWindowCloseHandler);
+	_dialogHandler = std::move(config.dialogHandler);
+	_asyncDialogHandler = std::move(config.asyncDialogHandler);
+	_dataRequestHandler = std::move(config.dataRequestHandler);
+	_dataRequestRedirectHost = std::move(config.dataRequestRedirectHost);
+	if (config.dataCacheLimit > 0) {
+		_dataCache.emplace(config.dataCacheLimit);
+	}
+	_dataSingleFlight.emplace([=](DataRequest request) {
+		if (_dataCache) {
+			request.done = crl::guard(this, [
+					=,
+					done = std::move(request.done),
+					id = request.id](DataResponse response) {
+				_dataCache->put(id, response);
+				done(std::move(response));
+			});
 		}
+		return _dataRequestHandler(std::move(request));
+	});
+	_dataServerThreadEnabled = config.dataServerThread;
+	_dataReadAhead = std::max(config.dataReadAhead, 0);
+	_dataCompressThreshold = config.dataCompressThreshold;
+	if (config.dataMetrics) {
+		_dataMetrics = std::make_unique<DataMetricsCollector>();
+	}
+	if (config.dataRedirectCacheLimit > 0 && !config.userDataPath.empty()) {
+		_dataRedirectCachePath = config.userDataPath + "/redirect_cache";
+		_dataRedirectCacheLimit = config.dataRedirectCacheLimit;
+	}
+	_windowStyle = config.windowStyle;
+	_windowMargins = config.windowMargins;
+	_shellMessageToken = std::move(config.shellMessageToken);
+}
 
-		if (!success.value_or(false)) {
-			return false;
-		}
+void Instance::createRemoteWidget(QWidget *parent) {
+	if (_mode == WindowMode::External) {
+		_widget = ::base::make_unique_q<QWidget>(parent);
+		return;
+	} else if (_mode == WindowMode::Hidden) {
+		return;
+	}
 
-		if (_mode == WindowMode::External) {
-			_widget = ::base::make_unique_q<QWidget>(config.parent);
-			return true;
-		} else if (_mode == WindowMode::Hidden) {
-			return true;
-		}
+	switch (_platform) {
+	case Platform::Any:
+		_widget = ::base::make_unique_q<QWidget>(parent);
+		::base::install_event_filter(_widget, [=](
+				not_null<QEvent*> e) {
+			if (e->type() == QEvent::Resize) {
+				const auto size = static_cast<QResizeEvent*>(
+					e.get()
+				)->size();
+				resize(size.width(), size.height());
+			}
+			return ::base::EventFilterResult::Continue;
+		});
+		break;
+	case Platform::X11:
+		const auto window = QPointer(QWindow::fromWinId(WId(winId())));
+		::base::install_event_filter(window, [=](
+				not_null<QEvent*> e) {
+			if (e->type() == QEvent::Show) {
+				GLib::timeout_add_seconds_once(1, crl::guard(window, [=] {
+					const auto size = window->size();
+					window->resize(0, 0);
+					window->resize(size);
+				}));
+			}
+			return ::base::EventFilterResult::Continue;
+		});
+		_widget.reset(
+			QWidget::createWindowContainer(
+				window,
+				parent,
+				Qt::FramelessWindowHint));
+		_widget->show();
+		break;
+	}
+}
 
-		switch (_platform) {
-		case Platform::Any:
-			_widget = ::base::make_unique_q<QWidget>(config.parent);
-			::base::install_event_filter(_widget, [=](
-					not_null<QEvent*> e) {
-				if (e->type() == QEvent::Resize) {
-					const auto size = static_cast<QResizeEvent*>(
-						e.get()
-					)->size();
-					resize(size.width(), size.height());
-				}
-				return ::base::EventFilterResult::Continue;
-			});
-			break;
-		case Platform::X11:
-			const auto window = QPointer(QWindow::fromWinId(WId(winId())));
-			::base::install_event_filter(window, [=](
-					not_null<QEvent*> e) {
-				if (e->type() == QEvent::Show) {
-					GLib::timeout_add_seconds_once(1, crl::guard(window, [=] {
-						const auto size = window->size();
-						window->resize(0, 0);
-						window->resize(size);
-					}));
-				}
-				return ::base::EventFilterResult::Continue;
-			});
-			_widget.reset(
-				QWidget::createWindowContainer(
-					window,
-					config.parent,
-					Qt::FramelessWindowHint));
-			_widget->show();
-			break;
+bool Instance::create(Config config) {
+	if (_remoting) {
+		auto result = std::optional<bool>();
+		create(std::move(config), [&](bool success) {
+			result = success;
+			GLib::MainContext::default_().wakeup();
+		});
+		while (!result) {
+			GLib::MainContext::default_().iteration(true);
 		}
-
-		return true;
+		return *result;
 	}
 
+	applyConfig(config);
+
 	_window = (_platform == Platform::X11)
 		&& (_mode == WindowMode::Embedded)
 		? gtk_plug_new(0)
 		: gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	++HelperWindows();
 	if (_mode == WindowMode::External) {
 		if (customWindowFrame()) {
 			gtk_window_set_decorated(GTK_WINDOW(_window), FALSE);
@@ -1094,6 +1702,50 @@ bool Instance::create(Config config) {
 		g_object_unref(context);
 	}
 
+	_dataProtocol = std::move(config.dataProtocolOverride);
+	_dataScheme = !_dataProtocol.empty() && CustomSchemeResponses();
+	if (_dataScheme) {
+		// A reset helper may get the same context for the next view, and
+		// the views of a shared helper may all use the default one.
+		const auto context = webkit_web_view_get_context(_webview);
+		const auto registered = "webview-scheme-" + _dataProtocol;
+		if (!g_object_get_data(G_OBJECT(context), registered.c_str())) {
+			webkit_web_context_register_uri_scheme(
+				context,
+				_dataProtocol.c_str(),
+				+[](WebKitURISchemeRequest *request, gpointer) {
+					const auto &views = SchemeViews();
+					const auto i = views.find(
+						webkit_uri_scheme_request_get_web_view(request));
+					if (i == end(views)) {
+						FinishSchemeRequestNotFound(request);
+						return;
+					}
+					i->second->schemeRequest(request);
+				},
+				nullptr,
+				nullptr);
+			g_object_set_data(
+				G_OBJECT(context),
+				registered.c_str(),
+				GINT_TO_POINTER(1));
+		}
+		SchemeViews().emplace(_webview, this);
+		const auto security = webkit_web_context_get_security_manager
+			? webkit_web_context_get_security_manager(context)
+			: nullptr;
+		if (security
+			&& webkit_security_manager_register_uri_scheme_as_secure
+			&& webkit_security_manager_register_uri_scheme_as_cors_enabled) {
+			webkit_security_manager_register_uri_scheme_as_secure(
+				security,
+				_dataProtocol.c_str());
+			webkit_security_manager_register_uri_scheme_as_cors_enabled(
+				security,
+				_dataProtocol.c_str());
+		}
+	}
+
 	WebKitUserContentManager *manager =
 		webkit_web_view_get_user_content_manager(_webview);
 	g_signal_connect_swapped(
@@ -1111,7 +1763,9 @@ bool Instance::create(Config config) {
 		G_CALLBACK(+[](Instance *instance) {
 			instance->clearWaylandPopupAnchorExport();
 			instance->_window = nullptr;
-			Gio::Application::get_default().quit();
+			if (!--HelperWindows()) {
+				Gio::Application::get_default().quit();
+			}
 		}),
 		this);
 	g_signal_connect_swapped(
@@ -1144,7 +1798,9 @@ bool Instance::create(Config config) {
 				Instance *instance,
 				WebKitWebProcessTerminationReason reason) {
 			g_critical("Web process terminated: %d.", reason);
-			Gio::Application::get_default().quit();
+			if (HelperWindows() == 1) {
+				Gio::Application::get_default().quit();
+			}
 		}),
 		this);
 	g_signal_connect_swapped(
@@ -1156,7 +1812,9 @@ bool Instance::create(Config config) {
 			if (!webkit_web_view_get_is_web_process_responsive(
 					instance->_webview)) {
 				g_critical("Web process became unresponsive.");
-				Gio::Application::get_default().quit();
+				if (HelperWindows() == 1) {
+					Gio::Application::get_default().quit();
+				}
 			}
 		}),
 		this);
@@ -1599,32 +2257,60 @@ bool Instance::decidePolicy(
 		= webkit_navigation_policy_decision_get_navigation_action(
 			navigationDecision);
 	WebKitURIRequest *request = webkit_navigation_action_get_request(action);
-	const gchar *uri = webkit_uri_request_get_uri(request);
-	bool result = false;
-	if (_master) {
-		auto loop = GLib::MainLoop::new_();
-		_master.call_navigation_started(uri, false, [&](
-				GObjectCpp::Object source_object,
-				Gio::AsyncResult res) {
-			if (const auto ret = _master.call_navigation_started_finish(
-					res)) {
-				result = std::get<1>(*ret);
-			}
-			loop.quit();
-		});
-		loop.run();
+	const std::string uri = webkit_uri_request_get_uri(request);
+	switch (DecideNavigation(_navigationPolicy, dataDomain(), uri)) {
+	case NavigationDecision::Allow:
+		scheduleNavigationDoneCheck();
+		return false;
+	case NavigationDecision::Block:
+		webkit_policy_decision_ignore(decision);
+		scheduleNavigationDoneCheck();
+		return true;
+	case NavigationDecision::Ask:
+		break;
 	}
-	if (!result) {
+	if (!_master) {
 		webkit_policy_decision_ignore(decision);
+		scheduleNavigationDoneCheck();
+		return true;
 	}
+
+	// WebKit waits for the decision, while the page keeps running.
+	g_object_ref(decision);
+	++_navigationAsksPending;
+	const auto decided = crl::guard(this, [=] {
+		--_navigationAsksPending;
+		scheduleNavigationDoneCheck();
+	});
+	_master.call_navigation_started(uri, false, [=, master = _master](
+			GObjectCpp::Object source_object,
+			Gio::AsyncResult res) mutable {
+		const auto ret = master.call_navigation_started_finish(res);
+		if (ret && std::get<1>(*ret)) {
+			webkit_policy_decision_use(decision);
+		} else {
+			webkit_policy_decision_ignore(decision);
+		}
+		g_object_unref(decision);
+		decided();
+	});
+	return true;
+}
+
+// Navigations that didn't start loading anything don't report being done,
+// so that is checked a second after the last one was decided. Not while
+// the master is still asked about some, its answer schedules a new check.
+void Instance::scheduleNavigationDoneCheck() {
+	const auto id = ++_navigationDoneCheckId;
 	GLib::timeout_add_seconds_once(1, crl::guard(this, [=] {
-		if (!webkit_web_view_is_loading(_webview)) {
-			if (_master) {
-				_master.call_navigation_done(!_loadFailed, nullptr);
-			}
+		if (id == _navigationDoneCheckId
+			&& !_navigationAsksPending
+			&& _webview
+			&& !webkit_web_view_is_loading(_webview)
+			&& _master) {
+			_master.call_navigation_done(!_loadFailed, nullptr);
 		}
 	}));
-	return !result;
 }
 
 GtkWidget *Instance::createAnother(WebKitNavigationAction *action) {
@@ -1633,7 +2319,9 @@ GtkWidget *Instance::createAnother(WebKitNavigationAction *action) {
 	}
 	WebKitURIRequest *request = webkit_navigation_action_get_request(action);
 	const std::string uri = webkit_uri_request_get_uri(request);
-	if (!_master) {
+	if (!_master
+		|| (DecideNavigation(_navigationPolicy, dataDomain(), uri)
+			== NavigationDecision::Block)) {
 		return nullptr;
 	}
 	_master.call_navigation_started(uri, true, [=](
@@ -1716,8 +2404,11 @@ bool Instance::authenticate(WebKitAuthenticationRequest *request) {
 		webkit_authentication_request_cancel(request);
 		return true;
 	}
-	if (strcmp(webkit_authentication_request_get_host(request), kDataHost)
-			|| webkit_authentication_request_get_port(request) != _dataPort) {
+	const auto host = webkit_authentication_request_get_host(request);
+	if (_dataHost.empty()
+		|| !host
+		|| host != _dataHost
+		|| webkit_authentication_request_get_port(request) != _dataPort) {
 		return false;
 	}
 	const auto credential = webkit_credential_new(
@@ -1754,193 +2445,851 @@ bool Instance::startDataServer() {
 		return true;
 	}
 
-	_dataServer.emplace(
-		(_dataPassword = GLib::uuid_string_random()).c_str(),
+	_dataServer = DataServer::Acquire(_dataServerThreadEnabled);
+	if (!_dataServer) {
+		return false;
+	}
+	_dataRoute = std::make_shared<DataRoute>(DataRoute::Descriptor{
+		.context = _dataServer->context(),
+		.metrics = _dataMetrics.get(),
+		.readAhead = _dataReadAhead,
+		.compressThreshold = _dataCompressThreshold,
+		.request = [=](DataRequest request) {
+			return _dataRequestHandler
+				? requestData(std::move(request))
+				: DataResult::Failed;
+		},
+	});
+	_dataPassword = GLib::uuid_string_random();
+	const auto endpoint = _dataServer->addRoute(
+		QByteArray::fromStdString(_dataPassword),
 		QByteArray::fromStdString(_dataRequestRedirectHost),
-		[=](
+		[route = _dataRoute](
 				QTcpSocket *socket,
-				const QByteArray &id,
-				const ::base::flat_map<QByteArray, QByteArray> &headers,
+				std::string_view id,
+				const HttpRequest &request,
 				const std::shared_ptr<HttpServer::Guard> &guard) {
-			if (!_dataRequestHandler) {
-				return;
-			}
-			const auto resourceId = id.toStdString();
-			auto prepared = DataRequest{
-				.id = resourceId,
-			};
-			const auto getHeader = [&](const QByteArray &key) {
-				const auto it = headers.find(key);
-				return it != headers.end()
-					? it->second
-					: QByteArray();
-			};
-			const auto rangeHeader = getHeader("Range");
-			if (!rangeHeader.isEmpty()) {
-				ParseRangeHeaderFor(prepared, rangeHeader.toStdString());
-			}
-			const auto requestedOffset = prepared.offset;
-			const auto requestedLimit = prepared.limit;
-			prepared.done = crl::guard(socket, [=](DataResponse resolved) {
-				dataRequest(
-					std::move(resolved),
-					socket,
-					resourceId,
-					requestedOffset,
-					requestedLimit,
-					false,
-					guard);
-			});
-			_dataRequestHandler(prepared);
+			route->handle(socket, id, request, guard);
 		});
-
-	if (!_dataServer->listen(QHostAddress::LocalHost)) {
-		LOG(("WebView Error: %1").arg(_dataServer->errorString()));
-		_dataServer.reset();
+	if (!endpoint) {
+		LOG(("WebView Error: Could not start the data server."));
+		::base::take(_dataRoute)->detach();
+		_dataServer = nullptr;
 		return false;
 	}
-
-	_dataPort = _dataServer->serverPort();
+	if (!_dataRequestRedirectHost.empty() && !_dataRedirectCachePath.empty()) {
+		_dataServer->setRedirectCache(
+			QString::fromStdString(_dataRedirectCachePath),
+			_dataRedirectCacheLimit);
+	}
+	_dataHost = endpoint->host;
+	_dataPort = endpoint->port;
 
 	if (_master) {
-		_master.emit_data_server_started(_dataPort, _dataPassword);
+		_master.emit_data_server_started(_dataHost, _dataPort, _dataPassword);
 	}
 
 	return true;
 }
 
+bool Instance::dataSchemeSupported() const {
+	return _dataSchemeSupported;
+}
+
+void Instance::stopDataServer() {
+	if (const auto route = ::base::take(_dataRoute)) {
+		route->detach();
+	}
+	if (const auto server = ::base::take(_dataServer)) {
+		server->removeRoute(QByteArray::fromStdString(_dataPassword));
+	}
+}
+
+// Origin of the data, without the secret path segment, so that the checks
+// against it also cover root-relative URLs accepted with Basic auth.
 std::string Instance::dataDomain() {
-	return std::format("http://{}:{}/", kDataHost, std::to_string(_dataPort));
+	if (_dataScheme) {
+		return _dataProtocol + "://domain/";
+	}
+	return std::format(
+		"http://{}:{}/",
+		_dataHost,
+		std::to_string(_dataPort));
+}
+
+DataResult Instance::requestData(DataRequest request) {
+	if (_dataCache) {
+		if (auto cached = _dataCache->find(request.id, request.offset)) {
+			request.done(std::move(*cached));
+			return DataResult::Done;
+		}
+	}
+	return _dataSingleFlight->request(std::move(request));
+}
+
+DataRoute::DataRoute(Descriptor &&descriptor)
+: _context(descriptor.context)
+, _metrics(descriptor.metrics)
+, _readAhead(std::max(descriptor.readAhead, 0))
+, _compressThreshold(descriptor.compressThreshold)
+, _request(std::move(descriptor.request)) {
+}
+
+void DataRoute::detach() {
+	_request = nullptr;
+}
+
+void DataRoute::handle(
+		QTcpSocket *socket,
+		std::string_view id,
+		const HttpRequest &request,
+		const std::shared_ptr<HttpServer::Guard> &guard) {
+	const auto resourceId = std::string(id);
+	auto prepared = DataRequest{
+		.id = resourceId,
+	};
+	const auto rangeHeader = request.header("Range");
+	const auto byteRanges = (rangeHeader.find(',') != rangeHeader.npos)
+		? ParseRangesHeader(rangeHeader)
+		: std::vector<DataRange>();
+	if (byteRanges.size() > 1) {
+		// One part from the first range till the last one, if it has
+		// all of them they are sent as multipart/byteranges, otherwise
+		// the whole span is sent as a single range.
+		const auto first = std::ranges::min(
+			byteRanges,
+			std::less<>(),
+			&DataRange::offset);
+		auto till = std::int64_t();
+		for (const auto &range : byteRanges) {
+			if (range.limit <= 0) {
+				till = -1;
+				break;
+			}
+			till = std::max(till, range.offset + range.limit);
+		}
+		prepared.offset = first.offset;
+		prepared.limit = (till > 0) ? (till - first.offset) : -1;
+	} else if (!rangeHeader.empty()) {
+		ParseRangeHeaderFor(prepared, rangeHeader);
+	}
+	const auto requestedOffset = prepared.offset;
+	const auto requestedLimit = prepared.limit;
+	const auto trace = _metrics
+		? _metrics->trace(resourceId, requestedOffset)
+		: nullptr;
+	const auto ifNoneMatch = std::string(
+		request.header("If-None-Match"));
+	const auto ifModifiedSince = std::string(
+		request.header("If-Modified-Since"));
+	// Whole responses may be sent encoded, so caches must key them by it.
+	const auto negotiable = rangeHeader.empty();
+	const auto acceptEncoding = negotiable
+		? std::string(request.header("Accept-Encoding"))
+		: std::string();
+	prepared.done = crl::guard(socket, [=](DataResponse resolved) {
+		auto matchedEncoding = std::string_view();
+		if (resolved.stream
+			&& NotModified(
+				resolved.freshness,
+				ifNoneMatch,
+				ifModifiedSince,
+				&matchedEncoding)) {
+			socket->write("HTTP/1.1 304 Not Modified\r\n");
+			if (negotiable) {
+				socket->write("Vary: Accept-Encoding\r\n");
+			}
+			socket->write(
+				FreshnessHeaders(resolved.freshness, matchedEncoding));
+			socket->write("\r\n");
+			if (trace) {
+				trace->responded(304);
+			}
+			guard->complete();
+			return;
+		} else if (byteRanges.size() > 1
+			&& respondRanges(
+				resolved,
+				socket,
+				byteRanges,
+				guard,
+				trace)) {
+			return;
+		} else if (!acceptEncoding.empty()
+			&& respondEncoded(
+				resolved,
+				socket,
+				acceptEncoding,
+				guard,
+				trace)) {
+			return;
+		}
+		respond(
+			std::move(resolved),
+			socket,
+			resourceId,
+			requestedOffset,
+			requestedLimit,
+			negotiable,
+			guard,
+			trace);
+	});
+	requestData(std::move(prepared), crl::guard(socket, [=] {
+		socket->write("HTTP/1.1 404 Not Found\r\n");
+		socket->write("Content-Length: 0\r\n");
+		socket->write("\r\n");
+		if (trace) {
+			trace->responded(404);
+		}
+		guard->complete();
+	}), trace);
+}
+
+// The handler and the cache are used only on the main thread, while the
+// sockets live on the data server thread if it is enabled.
+void DataRoute::requestData(
+		DataRequest request,
+		Fn<void()> failed,
+		std::shared_ptr<DataMetricsTrace> trace) {
+	if (trace) {
+		request.done = [=, done = std::move(request.done)](
+				DataResponse response) {
+			trace->resolved();
+			done(std::move(response));
+		};
+	}
+	if (!_context) {
+		if (trace) {
+			trace->started();
+		}
+		if ((!_request || _request(std::move(request)) == DataResult::Failed)
+				&& failed) {
+			failed();
+		}
+		return;
+	}
+	const auto weak = weak_from_this();
+	const auto context = _context;
+	crl::on_main([=, request = std::move(request)]() mutable {
+		const auto strong = weak.lock();
+		if (!strong || !strong->_request) {
+			return;
+		}
+		// The server is released only after the route is detached.
+		request.done = [=, done = std::move(request.done)](
+				DataResponse response) {
+			const auto strong = weak.lock();
+			if (!strong || !strong->_request) {
+				return;
+			}
+			const auto shared = std::make_shared<DataResponse>(
+				std::move(response));
+			QMetaObject::invokeMethod(context, [=] {
+				done(std::move(*shared));
+			});
+		};
+		if (trace) {
+			trace->started();
+		}
+		const auto result = strong->_request(std::move(request));
+		if (result == DataResult::Failed && failed) {
+			QMetaObject::invokeMethod(context, failed);
+		}
+	});
 }
 
-void Instance::dataRequest(
+void DataRoute::respond(
 		DataResponse resolved,
 		QTcpSocket *socket,
 		const std::string &resourceId,
 		std::int64_t requestedOffset,
 		std::int64_t requestedLimit,
-		bool headersWritten,
-		const std::shared_ptr<HttpServer::Guard> &guard) {
-	auto &stream = resolved.stream;
-	if (!stream) {
+		bool negotiable,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace) {
+	const auto slice = PrepareDataSlice(
+		resolved,
+		requestedOffset,
+		requestedLimit);
+	if (!slice) {
 		return;
 	}
-	const auto length = stream->size();
-	Assert(length > 0);
+	const auto useLength = slice->length;
+	const auto total = slice->total;
+	const auto partial = slice->partial;
+	requestedLimit = slice->limit;
+
+	socket->write("HTTP/1.1 ");
+	socket->write(partial ? "206 Partial Content\r\n" : "200 OK\r\n");
+
+	const auto mime = QByteArray(resolved.stream->mime());
+	socket->write("Content-Type: " + mime + "\r\n");
+	socket->write("Accept-Ranges: bytes\r\n");
+	if (negotiable) {
+		socket->write("Vary: Accept-Encoding\r\n");
+	}
+	socket->write(FreshnessHeaders(resolved.freshness));
+	socket->write("Content-Length: "
+		+ QByteArray::number(requestedLimit)
+		+ "\r\n");
+
+	if (partial) {
+		socket->write("Content-Range: bytes "
+			+ QByteArray::number(requestedOffset)
+			+ '-'
+			+ QByteArray::number(requestedOffset + requestedLimit - 1)
+			+ '/'
+			+ QByteArray::number(total)
+			+ "\r\n");
+	}
 
-	const auto offset = resolved.streamOffset;
-	if (requestedOffset >= offset + length || offset > requestedOffset) {
-		return;
+	socket->write("\r\n");
+	if (trace) {
+		trace->responded(partial ? 206 : 200);
 	}
 
-	auto bytes = QByteArray();
-	bytes.resize(length);
-	const auto read = stream->read(bytes.data(), length);
-	Assert(read == length);
+	// Next parts are guessed to be of the same size as the first one.
+	const auto state = std::make_shared<ReadAhead>(ReadAhead{
+		.socket = socket,
+		.resourceId = resourceId,
+		.guard = guard,
+		.trace = trace,
+		.position = requestedOffset + useLength,
+		.requested = requestedOffset + useLength,
+		.till = requestedOffset + requestedLimit,
+		.partSize = resolved.stream->size(),
+		.writing = true,
+	});
+	fillReadAhead(state);
+
+	SendStream(
+		socket,
+		std::move(resolved.stream),
+		useLength,
+		[=, weak = weak_from_this()](bool success) {
+			if (const auto strong = weak.lock(); strong && success) {
+				strong->writeReadAhead(state);
+			}
+		},
+		trace);
+}
 
-	const auto useOffset = (requestedOffset - offset);
-	const auto useLength = (requestedLimit > 0)
-		? std::min(requestedLimit, (length - useOffset))
-		: (length - useOffset);
+bool DataRoute::respondRanges(
+		DataResponse &resolved,
+		QTcpSocket *socket,
+		const std::vector<DataRange> &ranges,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace) {
+	auto body = ByteRangesStream(resolved, ranges);
+	if (!body) {
+		return false;
+	}
+	const auto size = body->size();
+	socket->write("HTTP/1.1 206 Partial Content\r\n");
+	socket->write("Content-Type: "
+		+ QByteArray::fromStdString(body->mime())
+		+ "\r\n");
+	socket->write("Accept-Ranges: bytes\r\n");
+	socket->write(FreshnessHeaders(resolved.freshness));
+	socket->write("Content-Length: " + QByteArray::number(size) + "\r\n");
+	socket->write("\r\n");
+	if (trace) {
+		trace->responded(206);
+	}
+
+	SendStream(
+		socket,
+		std::move(body),
+		size,
+		[=](bool success) {
+			if (success) {
+				guard->complete();
+			}
+		},
+		trace);
+	return true;
+}
 
-#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
-	bytes.slice(useOffset, useLength);
-#else // Qt >= 6.8.0
-	bytes = std::move(bytes.mid(useOffset, useLength));
-#endif // Qt < 6.8.0
+bool DataRoute::respondEncoded(
+		DataResponse &resolved,
+		QTcpSocket *socket,
+		std::string_view acceptEncoding,
+		const std::shared_ptr<HttpServer::Guard> &guard,
+		const std::shared_ptr<DataMetricsTrace> &trace) {
+	auto encoded = NegotiateEncoding(
+		resolved,
+		acceptEncoding,
+		_compressThreshold);
+	if (!encoded) {
+		return false;
+	}
+	const auto size = encoded->stream->size();
+	socket->write("HTTP/1.1 200 OK\r\n");
+	socket->write("Content-Type: "
+		+ QByteArray::fromStdString(resolved.stream->mime())
+		+ "\r\n");
+	socket->write("Content-Encoding: "
+		+ QByteArray::fromStdString(encoded->encoding)
+		+ "\r\n");
+	socket->write("Vary: Accept-Encoding\r\n");
+	socket->write(FreshnessHeaders(resolved.freshness, encoded->encoding));
+	socket->write("Content-Length: " + QByteArray::number(size) + "\r\n");
+	socket->write("\r\n");
+	if (trace) {
+		trace->responded(200);
+	}
+
+	SendStream(
+		socket,
+		std::move(encoded->stream),
+		size,
+		[=](bool success) {
+			if (success) {
+				guard->complete();
+			}
+		},
+		trace);
+	return true;
+}
 
-	const auto total = resolved.totalSize ? resolved.totalSize : length;
-	const auto partial = (requestedOffset > 0) || (requestedLimit > 0);
-	if (requestedLimit <= 0) {
-		requestedLimit = (total - requestedOffset);
+void DataRoute::fillReadAhead(const std::shared_ptr<ReadAhead> &state) {
+	const auto window = _readAhead + (state->writing ? 0 : 1);
+	while (state->requested < state->till
+		&& int(state->parts.size()) < window) {
+		const auto offset = state->requested;
+		const auto limit = std::min(
+			state->partSize,
+			state->till - offset);
+		state->parts.push_back({ .offset = offset, .limit = limit });
+		state->requested += limit;
+		requestReadAheadPart(state, offset, limit);
 	}
+}
+
+void DataRoute::requestReadAheadPart(
+		const std::shared_ptr<ReadAhead> &state,
+		std::int64_t offset,
+		std::int64_t limit) {
+	const auto socket = state->socket;
+	requestData({
+		.id = state->resourceId,
+		.offset = offset,
+		.limit = limit,
+		.done = crl::guard(socket, [=](DataResponse resolved) {
+			const auto i = std::ranges::find(
+				state->parts,
+				offset,
+				&ReadAhead::Part::offset);
+			if (i == end(state->parts) || i->response) {
+				return;
+			}
+			i->response = std::move(resolved);
+			if (!state->writing) {
+				writeReadAhead(state);
+			}
+		}),
+	}, nullptr);
+}
 
-	if (!headersWritten) {
-		socket->write("HTTP/1.1 ");
-		socket->write(partial ? "206 Partial Content\r\n" : "200 OK\r\n");
+void DataRoute::writeReadAhead(const std::shared_ptr<ReadAhead> &state) {
+	if (state->position == state->till) {
+		state->guard->complete();
+		return;
+	} else if (state->parts.empty() || !state->parts.front().response) {
+		state->writing = false;
+		fillReadAhead(state);
+		return;
+	}
+	auto part = std::move(state->parts.front());
+	state->parts.pop_front();
+	const auto slice = PrepareDataSlice(
+		*part.response,
+		part.offset,
+		part.limit);
+	if (!slice) {
+		return;
+	}
+	state->writing = true;
+	state->position += slice->length;
+	if (slice->length < part.limit) {
+		// The handler returned a shorter part, the rest is needed next.
+		const auto offset = part.offset + slice->length;
+		const auto limit = part.limit - slice->length;
+		state->parts.push_front({ .offset = offset, .limit = limit });
+		requestReadAheadPart(state, offset, limit);
+	}
+	fillReadAhead(state);
+
+	SendStream(
+		state->socket,
+		std::move(part.response->stream),
+		slice->length,
+		[=, weak = weak_from_this()](bool success) {
+			if (const auto strong = weak.lock(); strong && success) {
+				strong->writeReadAhead(state);
+			}
+		},
+		state->trace);
+}
 
-		const auto mime = QByteArray(stream->mime());
-		socket->write("Content-Type: " + mime + "\r\n");
-		socket->write("Accept-Ranges: bytes\r\n");
-		socket->write("Cache-Control: no-store\r\n");
-		socket->write("Content-Length: "
-			+ QByteArray::number(requestedLimit)
-			+ "\r\n");
+void Instance::startDataTransfer(
+		Gio::DBusMethodInvocation invocation,
+		const std::string &resourceId,
+		DataResponse resolved,
+		std::int64_t requestedOffset,
+		std::int64_t requestedLimit) {
+	if (!_master) {
+		return;
+	}
+	const auto slice = PrepareDataSlice(
+		resolved,
+		requestedOffset,
+		requestedLimit);
+	if (!slice) {
+		_master.complete_data_request(
+			invocation,
+			false,
+			0,
+			std::string(),
+			false,
+			0,
+			0,
+			0,
+			std::string());
+		return;
+	}
+	const auto id = ++_dataTransferAutoincrement;
+	const auto mime = resolved.stream->mime();
+	_dataTransfers.emplace(id, DataTransfer{
+		.resourceId = resourceId,
+		.stream = std::move(resolved.stream),
+		.streamLeft = slice->length,
+		.nextOffset = requestedOffset + slice->length,
+		.left = slice->limit,
+	});
+	_master.complete_data_request(
+		invocation,
+		true,
+		id,
+		mime,
+		slice->partial,
+		requestedOffset,
+		slice->limit,
+		slice->total,
+		FreshnessHeaders(resolved.freshness).toStdString());
+}
 
-		if (partial) {
-			socket->write("Content-Range: bytes "
-				+ QByteArray::number(requestedOffset)
-				+ '-'
-				+ QByteArray::number(requestedOffset + requestedLimit - 1)
-				+ '/'
-				+ QByteArray::number(total)
-				+ "\r\n");
+void Instance::readDataTransfer(
+		Gio::DBusMethodInvocation invocation,
+		std::uint64_t id) {
+	if (!_master) {
+		return;
+	}
+	const auto i = _dataTransfers.find(id);
+	if (i == end(_dataTransfers)) {
+		_master.complete_data_read(invocation, BytesToVariant({}));
+		return;
+	}
+	// Dropping the transfer completes the read, the callbacks below
+	// return right away if it was dropped while they were pending.
+	const auto fail = [=] {
+		dropDataTransfer(id);
+	};
+	auto &transfer = i->second;
+	transfer.reading = invocation;
+	if (!transfer.streamLeft) {
+		// The handler returned a shorter part, ask for the next one.
+		const auto nextOffset = transfer.nextOffset;
+		const auto nextLimit = transfer.left;
+		const auto result = requestData({
+			.id = transfer.resourceId,
+			.offset = nextOffset,
+			.limit = nextLimit,
+			.done = crl::guard(this, [=](DataResponse resolved) {
+				const auto i = _dataTransfers.find(id);
+				if (i == end(_dataTransfers)) {
+					return;
+				}
+				const auto slice = PrepareDataSlice(
+					resolved,
+					nextOffset,
+					nextLimit);
+				if (!slice) {
+					fail();
+					return;
+				}
+				auto &transfer = i->second;
+				transfer.stream = std::move(resolved.stream);
+				transfer.streamLeft = slice->length;
+				transfer.nextOffset = nextOffset + slice->length;
+				readDataTransfer(invocation, id);
+			}),
+		});
+		if (result == DataResult::Failed) {
+			fail();
+		}
+		return;
+	}
+	const auto size = std::min(transfer.streamLeft, kDataTransferChunk);
+	transfer.stream->next(size, crl::guard(this, [=](DataChunk chunk) {
+		const auto i = _dataTransfers.find(id);
+		if (i == end(_dataTransfers)) {
+			return;
+		} else if (chunk.size <= 0) {
+			LOG(("WebView Error: Could not read data stream."));
+			fail();
+			return;
 		}
+		const auto read = std::min(chunk.size, size);
+		const auto bytes = BytesToVariant(std::string_view(chunk.bytes, read));
+		auto &transfer = i->second;
+		transfer.streamLeft -= read;
+		transfer.left -= read;
+		transfer.reading = std::nullopt;
+		if (transfer.left <= 0) {
+			_dataTransfers.erase(i);
+		}
+		_master.complete_data_read(invocation, bytes);
+	}));
+}
 
-		socket->write("\r\n");
-		headersWritten = true;
+// A read still waiting for the stream gets an empty chunk, the stream
+// is destroyed with the transfer and won't ever call it back.
+void Instance::dropDataTransfer(std::uint64_t id) {
+	const auto i = _dataTransfers.find(id);
+	if (i == end(_dataTransfers)) {
+		return;
+	}
+	const auto reading = ::base::take(i->second.reading);
+	_dataTransfers.erase(i);
+	if (reading && _master) {
+		_master.complete_data_read(*reading, BytesToVariant({}));
 	}
+}
+
+void Instance::dropDataTransfers() {
+	while (!_dataTransfers.empty()) {
+		dropDataTransfer(_dataTransfers.begin()->first);
+	}
+}
+
+void Instance::schemeRequest(WebKitURISchemeRequest *request) {
+	const auto uri = std::string_view(
+		webkit_uri_scheme_request_get_uri(request));
+	const auto domain = dataDomain();
+	if (!_master || !uri.starts_with(domain)) {
+		FinishSchemeRequestNotFound(request);
+		return;
+	}
+	auto prepared = DataRequest{
+		.id = std::string(uri.substr(domain.size())),
+	};
+	const auto headers = webkit_uri_scheme_request_get_http_headers(request);
+	if (const auto range = headers
+			? soup_message_headers_get_one(headers, "Range")
+			: nullptr) {
+		ParseRangeHeaderFor(prepared, range);
+	}
+
+	g_object_ref(request);
+	_master.call_data_request(
+		prepared.id,
+		prepared.offset,
+		prepared.limit,
+		crl::guard(this, [=](
+				GObjectCpp::Object source_object,
+				Gio::AsyncResult res) {
+			const auto guard = gsl::finally([&] {
+				g_object_unref(request);
+			});
+			const auto reply = _master.call_data_request_finish(res);
+			if (!reply || !std::get<1>(*reply)) {
+				FinishSchemeRequestNotFound(request);
+				return;
+			}
+			schemeRespond(
+				request,
+				std::get<2>(*reply),
+				std::get<3>(*reply),
+				std::get<4>(*reply),
+				std::get<5>(*reply),
+				std::get<6>(*reply),
+				std::get<7>(*reply),
+				std::get<8>(*reply));
+		}));
+}
 
-	socket->write(bytes);
-	if (requestedLimit == useLength) {
+void Instance::schemeRespond(
+		WebKitURISchemeRequest *request,
+		std::uint64_t transfer,
+		const std::string &mime,
+		bool partial,
+		std::int64_t start,
+		std::int64_t length,
+		std::int64_t total,
+		const std::string &headers) {
+	int pipefd[2] = { -1, -1 };
+	GError *error = nullptr;
+	if (!g_unix_open_pipe(pipefd, O_CLOEXEC, &error)
+			&& (error || !g_unix_open_pipe(pipefd, FD_CLOEXEC, &error))) {
+		LOG(("WebView Error: %1").arg(error->message));
+		g_clear_error(&error);
+		_master.call_data_cancel(transfer, nullptr);
+		FinishSchemeRequestNotFound(request);
 		return;
 	}
+	// WebKit reads asynchronously, the chunks are written the same way.
+	g_unix_set_fd_nonblocking(pipefd[1], true, nullptr);
+
+#if __has_include(<giounix/giounix.hpp>)
+	auto input = GioUnix::InputStream::new_(pipefd[0], true);
+	auto output = GioUnix::OutputStream::new_(pipefd[1], true);
+#else // __has_include(<giounix/giounix.hpp>)
+	auto input = Gio::UnixInputStream::new_(pipefd[0], true);
+	auto output = Gio::UnixOutputStream::new_(pipefd[1], true);
+#endif // !__has_include(<giounix/giounix.hpp>)
 
-	requestedOffset += useLength;
-	requestedLimit -= useLength;
+	const auto response = webkit_uri_scheme_response_new(
+		G_INPUT_STREAM(input.gobj_()),
+		length);
+	webkit_uri_scheme_response_set_status(
+		response,
+		partial ? 206 : 200,
+		nullptr);
+	webkit_uri_scheme_response_set_content_type(response, mime.c_str());
+
+	const auto list = soup_message_headers_new(
+		SOUP_MESSAGE_HEADERS_RESPONSE);
+	soup_message_headers_append(list, "Accept-Ranges", "bytes");
+	if (partial) {
+		const auto range = std::format(
+			"bytes {}-{}/{}",
+			start,
+			start + length - 1,
+			total);
+		soup_message_headers_append(list, "Content-Range", range.c_str());
+	}
+	for (const auto &line : QByteArray::fromStdString(headers).split('\n')) {
+		const auto colon = line.indexOf(':');
+		if (colon > 0) {
+			soup_message_headers_append(
+				list,
+				line.left(colon).trimmed().constData(),
+				line.mid(colon + 1).trimmed().constData());
+		}
+	}
+	webkit_uri_scheme_response_set_http_headers(response, list);
+	webkit_uri_scheme_request_finish_with_response(request, response);
+	g_object_unref(response);
 
-	_dataRequestHandler({
-		.id = resourceId,
-		.offset = requestedOffset,
-		.limit = requestedLimit,
-		.done = crl::guard(socket, [=](DataResponse resolved) {
-			dataRequest(
-				std::move(resolved),
-				socket,
-				resourceId,
-				requestedOffset,
-				requestedLimit,
-				headersWritten,
-				guard);
-		}),
+	_schemeTransfers.emplace(transfer, SchemeTransfer{
+		.output = G_OUTPUT_STREAM(g_object_ref(output.gobj_())),
+		.left = length,
 	});
+	schemeRead(transfer);
+}
+
+void Instance::schemeRead(std::uint64_t transfer) {
+	_master.call_data_read(transfer, crl::guard(this, [=](
+			GObjectCpp::Object source_object,
+			Gio::AsyncResult res) {
+		const auto reply = _master.call_data_read_finish(res);
+		const auto i = _schemeTransfers.find(transfer);
+		if (i == end(_schemeTransfers)) {
+			return;
+		}
+		auto bytes = reply
+			? VariantToBytes(std::get<1>(*reply))
+			: std::string();
+		if (bytes.empty()) {
+			schemeFinish(transfer, false);
+			return;
+		}
+		const auto left = (i->second.left -= bytes.size());
+		WriteAllAsync(
+			i->second.output,
+			std::move(bytes),
+			crl::guard(this, [=](bool written) {
+				if (!written) {
+					// WebKit closed the reading end.
+					schemeFinish(transfer, true);
+				} else if (left <= 0) {
+					schemeFinish(transfer, false);
+				} else {
+					schemeRead(transfer);
+				}
+			}));
+	}));
+}
+
+void Instance::schemeFinish(std::uint64_t transfer, bool cancel) {
+	const auto i = _schemeTransfers.find(transfer);
+	if (i == end(_schemeTransfers)) {
+		return;
+	}
+	const auto output = i->second.output;
+	_schemeTransfers.erase(i);
+	g_output_stream_close(output, nullptr, nullptr);
+	g_object_unref(output);
+	if (cancel && _master) {
+		_master.call_data_cancel(transfer, nullptr);
+	}
 }
 
 ResolveResult Instance::resolve() {
 	if (_remoting) {
-		if (!_helper) {
-			return ResolveResult::IPCFailure;
+		auto result = std::optional<ResolveResult>();
+		resolve([&](ResolveResult value) {
+			result = value;
+			GLib::MainContext::default_().wakeup();
+		});
+		while (!result) {
+			GLib::MainContext::default_().iteration(true);
 		}
+		return *result;
+	}
 
-		const ::base::has_weak_ptr guard;
-		std::optional<ResolveResult> result;
-		_helper.call_resolve(crl::guard(&guard, [&](
-				GObjectCpp::Object source_object,
-				Gio::AsyncResult res) {
-			const auto reply = _helper.call_resolve_finish(res);
-			if (reply) {
-				result = ResolveResult(std::get<1>(*reply));
-			}
-			GLib::MainContext::default_().wakeup();
-		}));
+	return Resolve(_platform, _mode);
+}
 
-		while (!result && _connected) {
-			GLib::MainContext::default_().iteration(true);
+void Instance::resolve(Fn<void(ResolveResult)> done) {
+	if (!_remoting) {
+		done(Resolve(_platform, _mode));
+		return;
+	} else if (_resolved) {
+		done(*_resolved);
+		return;
+	} else if (!_helper || !_connected) {
+		done(ResolveResult::IPCFailure);
+		return;
+	}
+
+	_helper.call_resolve(crl::guard(this, [=](
+			GObjectCpp::Object source_object,
+			Gio::AsyncResult res) {
+		const auto reply = _helper.call_resolve_finish(res);
+		if (!reply) {
+			done(ResolveResult::IPCFailure);
+			return;
 		}
+		const auto result = ResolveResult(std::get<1>(*reply));
+		_dataSchemeSupported = std::get<2>(*reply);
+		_library = std::get<3>(*reply);
 
 		if (_platform != Platform::Any
-				&& result
-				&& *result != ResolveResult::Success) {
+				&& result != ResolveResult::Success) {
 			_platform = Platform::Any;
 			stopProcess();
-			startProcess();
-			return resolve();
+			startProcess([=] {
+				resolve(done);
+			});
+			return;
+		} else if (result == ResolveResult::Success) {
+			_resolved = result;
 		}
 
-		return result.value_or(ResolveResult::IPCFailure);
-	}
-
-	return Resolve(_platform, _mode);
+		done(result);
+	}));
 }
 
 void Instance::navigate(std::string url) {
@@ -1957,8 +3306,12 @@ void Instance::navigate(std::string url) {
 }
 
 void Instance::navigateToData(std::string id) {
-	startDataServer();
-	navigate(dataDomain() + id);
+	if (!_dataScheme && !startDataServer()) {
+		return;
+	}
+	navigate(_dataScheme
+		? (dataDomain() + id)
+		: (dataDomain() + _dataPassword + '/' + id));
 }
 
 void Instance::loadHtml(std::string html, std::string baseUrl) {
@@ -2459,6 +3812,33 @@ auto Instance::navigationHistoryState()
 	return _navigationHistoryState.value();
 }
 
+DataCacheStats Instance::dataCacheStats() {
+	return _dataCache ? _dataCache->stats() : DataCacheStats();
+}
+
+void Instance::invalidateData(const std::string &id) {
+	if (_dataCache) {
+		_dataCache->invalidate(id);
+	}
+}
+
+DataMetrics Instance::dataMetrics() {
+	if (!_dataMetrics) {
+		return {};
+	}
+	auto result = _dataMetrics->snapshot();
+	result.cache = dataCacheStats();
+	result.coalesced = _dataSingleFlight ? _dataSingleFlight->coalesced() : 0;
+	return result;
+}
+
+auto Instance::dataRequestMetrics() -> rpl::producer<DataRequestMetrics> {
+	if (!_dataMetrics) {
+		return rpl::never<DataRequestMetrics>();
+	}
+	return _dataMetrics->requests();
+}
+
 void Instance::setOpaqueBg(QColor opaqueBg) {
 	if (_remoting) {
 #ifdef DESKTOP_APP_WEBVIEW_WAYLAND_COMPOSITOR
@@ -2567,7 +3947,17 @@ void Instance::setFullscreen(bool fullscreen) {
 
 void Instance::startProcess() {
 	auto loop = GLib::MainLoop::new_();
+	auto finished = false;
+	startProcess([&] {
+		finished = true;
+		loop.quit();
+	});
+	if (!finished) {
+		loop.run();
+	}
+}
 
+void Instance::startProcess(Fn<void()> finished) {
 	auto serviceLauncher = Gio::SubprocessLauncher::new_(
 		Gio::SubprocessFlags::NONE_);
 
@@ -2593,6 +3983,7 @@ void Instance::startProcess() {
 			&& (error || !g_unix_open_pipe(pipefd, FD_CLOEXEC, &error))) {
 		LOG(("WebView Error: %1").arg(error->message));
 		g_clear_error(&error);
+		finished();
 		return;
 	}
 
@@ -2610,6 +4001,7 @@ void Instance::startProcess() {
 	if (!serviceProcess) {
 		LOG(("WebView Error: %1").arg(
 			serviceProcess.error().message_().c_str()));
+		finished();
 		return;
 	}
 
@@ -2623,6 +4015,7 @@ void Instance::startProcess() {
 
 	if (socketPath.empty()) {
 		LOG(("WebView Error: IPC socket path is not set."));
+		finished();
 		return;
 	}
 
@@ -2634,13 +4027,14 @@ void Instance::startProcess() {
 				GLib::path_get_basename(socketPath + "-wayland")));
 	}
 
+	// The server may outlive this instance when the process is adopted.
+	const auto pid = std::stoi(_serviceProcess.get_identifier());
 	auto authObserver = Gio::DBusAuthObserver::new_();
 	authObserver.signal_authorize_authenticated_peer().connect([=](
 			Gio::DBusAuthObserver,
 			Gio::IOStream stream,
 			Gio::Credentials credentials) {
-		return credentials.get_unix_pid(nullptr)
-			== std::stoi(_serviceProcess.get_identifier());
+		return credentials.get_unix_pid(nullptr) == pid;
 	});
 
 	auto dbusServer = Gio::DBusServer::new_sync(
@@ -2653,15 +4047,37 @@ void Instance::startProcess() {
 	if (!dbusServer) {
 		LOG(("WebView Error: %1.").arg(
 			dbusServer.error().message_().c_str()));
+		finished();
 		return;
 	}
 
 	_dbusServer = *dbusServer;
 	_dbusServer.start();
-	const ::base::has_weak_ptr guard;
-	auto started = ulong();
-	const auto newConnection = _dbusServer.signal_new_connection().connect(
-		[&](
+
+	struct State {
+		Fn<void()> finished;
+		ulong started = 0;
+		ulong newConnection = 0;
+		guint timeout = 0;
+	};
+	const auto state = std::make_shared<State>(State{
+		.finished = std::move(finished),
+	});
+	const auto finish = [=] {
+		const auto callback = ::base::take(state->finished);
+		if (!callback) {
+			return;
+		}
+		if (state->timeout) {
+			GLib::Source::remove(::base::take(state->timeout));
+		}
+		if (_helper && state->started) {
+			_helper.disconnect(::base::take(state->started));
+		}
+		_dbusServer.disconnect(state->newConnection);
+		callback();
+	};
+	state->newConnection = _dbusServer.signal_new_connection().connect([=](
 			Gio::DBusServer,
 			Gio::DBusConnection connection) {
 		_master = MasterSkeleton::new_();
@@ -2671,63 +4087,255 @@ void Instance::startProcess() {
 		_dbusObjectManager.export_(object);
 		_dbusObjectManager.set_connection(connection);
 		registerMasterMethodHandlers();
+		_connection = connection;
+		watchConnection();
 
 		HelperProxy::new_(
 			connection,
 			Gio::DBusProxyFlags::NONE_,
 			kHelperObjectPath,
-			crl::guard(&guard, [&](
+			crl::guard(this, [=](
 					GObjectCpp::Object source_object,
 					Gio::AsyncResult res) {
 				auto helper = HelperProxy::new_finish(res);
 				if (!helper) {
 					LOG(("WebView Error: %1").arg(
 						helper.error().message_().c_str()));
-					loop.quit();
+					finish();
 					return;
 				}
 
 				_helper = *helper;
 
-				started = _helper.signal_started().connect([&](Helper) {
+				state->started = _helper.signal_started().connect([=](
+						Helper) {
 					_connected = true;
-					loop.quit();
+					finish();
 				});
 			}));
 
-		connection.signal_closed().connect(crl::guard(this, [=](
-				Gio::DBusConnection,
-				bool remotePeerVanished,
-				GLib::Error_Ref error) {
-			_connected = false;
-			_widget = nullptr;
-			GLib::MainContext::default_().wakeup();
-		}));
-
 		return true;
 	});
 
 	// timeout in case something goes wrong
-	bool timeoutHappened = false;
-	const auto timeout = GLib::timeout_add_seconds_once(5, [&] {
-		timeoutHappened = true;
-		loop.quit();
-	});
+	state->timeout = GLib::timeout_add_seconds_once(5, crl::guard(this, [=] {
+		state->timeout = 0;
+		LOG(("WebView Error: Timed out waiting for WebView helper process."));
+		finish();
+	}));
 
 	pipeGuard.reset();
-	loop.run();
-	if (timeoutHappened) {
-		LOG(("WebView Error: Timed out waiting for WebView helper process."));
-	} else {
-		GLib::Source::remove(timeout);
+}
+
+void Instance::watchConnection() {
+	const auto closed = crl::guard(this, [=](
+			Gio::DBusConnection,
+			bool remotePeerVanished,
+			GLib::Error_Ref error) {
+		_connected = false;
+		_widget = nullptr;
+		dropDataTransfers();
+		GLib::MainContext::default_().wakeup();
+	});
+	_connectionClosed = _connection.signal_closed().connect(closed);
+}
+
+void Instance::warmUp(Fn<void(bool)> done) {
+	startProcess([=] {
+		resolve([=](ResolveResult result) {
+			done((result == ResolveResult::Success)
+				&& Poolable(_platform, _mode));
+		});
+	});
+}
+
+void Instance::resetProcess(Fn<void(bool)> done) {
+	if (!_helper || !_connected) {
+		done(false);
+		return;
 	}
-	if (_helper && started) {
-		_helper.disconnect(started);
+	const auto failed = [=] {
+		// Don't give this helper another chance.
+		_resolved = std::nullopt;
+		done(false);
+	};
+	_helper.call_reset(crl::guard(this, [=](
+			GObjectCpp::Object source_object,
+			Gio::AsyncResult res) {
+		if (!_helper.call_reset_finish(res, nullptr)) {
+			failed();
+			return;
+		}
+		// The helper answers Reset before its main loop gets to anything
+		// the destroyed view left, so make sure it still answers after.
+		_helper.call_resolve(crl::guard(this, [=](
+				GObjectCpp::Object source_object,
+				Gio::AsyncResult res) {
+			const auto reply = _helper.call_resolve_finish(res);
+			if (!reply
+				|| !_connected
+				|| (ResolveResult(std::get<1>(*reply))
+					!= ResolveResult::Success)) {
+				failed();
+				return;
+			}
+			done(true);
+		}));
+	}));
+}
+
+Platform Instance::platform() const {
+	return _platform;
+}
+
+const std::string &Instance::library() const {
+	return _library;
+}
+
+WindowMode Instance::mode() const {
+	return _mode;
+}
+
+bool Instance::connected() const {
+	return _connected;
+}
+
+bool Instance::recycleProcess() {
+	if (_shared
+		|| !_connected
+		|| !_resolved
+		|| !HelperPool::Get().wants(_platform, _mode)) {
+		return false;
+	}
+	auto recycled = std::make_unique<Instance>(true, _mode, false);
+	recycled->adoptProcess(*this);
+	HelperPool::Get().recycle(std::move(recycled));
+	return true;
+}
+
+// The helper keeps talking to the same object path, the new master object
+// replaces the one exported by the instance the process is taken from.
+void Instance::adoptProcess(Instance &from) {
+	_platform = from._platform;
+	_glBackend = from._glBackend;
+	_resolved = ::base::take(from._resolved);
+	_dataSchemeSupported = from._dataSchemeSupported;
+	_library = from._library;
+	_serviceProcess = ::base::take(from._serviceProcess);
+	_dbusServer = ::base::take(from._dbusServer);
+	_dbusObjectManager = ::base::take(from._dbusObjectManager);
+	_helper = ::base::take(from._helper);
+	_connection = ::base::take(from._connection);
+	_connected = ::base::take(from._connected);
+	_connection.disconnect(::base::take(from._connectionClosed));
+
+	_master = MasterSkeleton::new_();
+	auto object = ObjectSkeleton::new_(kMasterObjectPath);
+	object.set_master(_master);
+	_dbusObjectManager.export_(object);
+	registerMasterMethodHandlers();
+	watchConnection();
+}
+
+void Instance::startShared(std::string group, Fn<void()> finished) {
+	if (const auto process = SharedProcess::Find(_mode, group)) {
+		attachView(process, std::move(finished));
+		return;
+	}
+	startProcess([=] {
+		resolve([=](ResolveResult result) {
+			if (result == ResolveResult::Success
+					&& Shareable(_platform, _mode)) {
+				_shared = std::make_shared<SharedProcess>();
+				_shared->process = _serviceProcess;
+				_shared->server = _dbusServer;
+				_shared->objectManager = _dbusObjectManager;
+				_shared->connection = _connection;
+				_shared->host = _helper;
+				_shared->platform = _platform;
+				_shared->mode = _mode;
+				_shared->group = group;
+				_shared->dataSchemeSupported = _dataSchemeSupported;
+				_shared->library = _library;
+				SharedProcess::Register(_shared);
+			}
+			finished();
+		});
+	});
+}
+
+void Instance::attachView(
+		std::shared_ptr<SharedProcess> process,
+		Fn<void()> finished) {
+	_shared = std::move(process);
+	_viewId = ++_shared->viewAutoincrement;
+	_platform = _shared->platform;
+	_resolved = ResolveResult::Success;
+	_dataSchemeSupported = _shared->dataSchemeSupported;
+	_library = _shared->library;
+	_connection = _shared->connection;
+	_dbusObjectManager = _shared->objectManager;
+
+	_master = MasterSkeleton::new_();
+	auto object = ObjectSkeleton::new_(
+		ViewObjectPath(kMasterObjectPath, _viewId));
+	object.set_master(_master);
+	_dbusObjectManager.export_(object);
+	registerMasterMethodHandlers();
+	watchConnection();
+
+	const auto id = _viewId;
+	_shared->host.call_add_view(id, crl::guard(this, [=](
+			GObjectCpp::Object source_object,
+			Gio::AsyncResult res) {
+		if (!_shared || !_shared->host.call_add_view_finish(res, nullptr)) {
+			LOG(("WebView Error: Could not add a view to the helper."));
+			finished();
+			return;
+		}
+		HelperProxy::new_(
+			_connection,
+			Gio::DBusProxyFlags::NONE_,
+			ViewObjectPath(kHelperObjectPath, id),
+			crl::guard(this, [=](
+					GObjectCpp::Object source_object,
+					Gio::AsyncResult res) {
+				auto helper = HelperProxy::new_finish(res);
+				if (!helper) {
+					LOG(("WebView Error: %1").arg(
+						helper.error().message_().c_str()));
+					finished();
+					return;
+				}
+				_helper = *helper;
+				_connected = true;
+				finished();
+			}));
+	}));
+}
+
+// Only the view goes away, the process stays with the other instances.
+void Instance::detachView() {
+	const auto shared = ::base::take(_shared);
+	const auto id = ::base::take(_viewId);
+	if (shared->connected) {
+		if (id) {
+			shared->host.call_remove_view(id, nullptr);
+		} else if (_helper) {
+			_helper.call_reset(nullptr);
+		}
 	}
-	_dbusServer.disconnect(newConnection);
+	_dbusObjectManager.unexport(ViewObjectPath(kMasterObjectPath, id));
+	_connection.disconnect(::base::take(_connectionClosed));
+	_connected = false;
 }
 
 void Instance::stopProcess() {
+	_resolved = std::nullopt;
+	if (_shared) {
+		detachView();
+		return;
+	}
 	if (_dbusServer) {
 		_dbusServer.stop();
 	}
@@ -2932,6 +4540,65 @@ void Instance::registerMasterMethodHandlers() {
 		_master.complete_user_interaction(invocation);
 		return true;
 	});
+
+	_master.signal_handle_data_request().connect([=](
+			Master,
+			Gio::DBusMethodInvocation invocation,
+			const std::string &id,
+			std::int64_t offset,
+			std::int64_t limit) {
+		const auto notFound = [=] {
+			_master.complete_data_request(
+				invocation,
+				false,
+				0,
+				std::string(),
+				false,
+				0,
+				0,
+				0,
+				std::string());
+		};
+		if (!_dataRequestHandler) {
+			notFound();
+			return true;
+		}
+		const auto resourceId = id;
+		const auto result = requestData({
+			.id = resourceId,
+			.offset = offset,
+			.limit = limit,
+			.done = crl::guard(this, [=](DataResponse resolved) {
+				startDataTransfer(
+					invocation,
+					resourceId,
+					std::move(resolved),
+					offset,
+					limit);
+			}),
+		});
+		if (result == DataResult::Failed) {
+			notFound();
+		}
+		return true;
+	});
+
+	_master.signal_handle_data_read().connect([=](
+			Master,
+			Gio::DBusMethodInvocation invocation,
+			std::uint64_t transfer) {
+		readDataTransfer(invocation, transfer);
+		return true;
+	});
+
+	_master.signal_handle_data_cancel().connect([=](
+			Master,
+			Gio::DBusMethodInvocation invocation,
+			std::uint64_t transfer) {
+		dropDataTransfer(transfer);
+		_master.complete_data_cancel(invocation);
+		return true;
+	});
 }
 
 int Instance::exec() {
@@ -2946,6 +4613,9 @@ int Instance::exec() {
 
 	app.hold();
 
+	// Custom scheme responses are written to pipes WebKit may close early.
+	signal(SIGPIPE, SIG_IGN);
+
 	auto loop = GLib::MainLoop::new_();
 
 	std::uint8_t dummy{};
@@ -2976,6 +4646,7 @@ int Instance::exec() {
 	_dbusObjectManager.export_(object);
 	_dbusObjectManager.set_connection(*connection);
 	registerHelperMethodHandlers();
+	registerHostMethodHandlers(*connection);
 
 	bool error = false;
 	MasterProxy::new_(
@@ -3031,8 +4702,10 @@ int Instance::exec() {
 
 	_master.signal_data_server_started().connect([=](
 			Master,
+			const std::string &host,
 			std::uint16_t port,
 			const std::string &password) {
+		_dataHost = host;
 		_dataPort = port;
 		_dataPassword = password;
 	});
@@ -3040,6 +4713,86 @@ int Instance::exec() {
 	return app.run({});
 }
 
+void Instance::registerHostMethodHandlers(Gio::DBusConnection connection) {
+	_helper.signal_handle_add_view().connect([=](
+			Helper,
+			Gio::DBusMethodInvocation invocation,
+			std::uint64_t id) {
+		auto view = std::make_unique<Instance>(false, _mode);
+		const auto raw = view.get();
+		_views.emplace(id, std::move(view));
+		raw->exportView(
+			connection,
+			_dbusObjectManager,
+			_platform,
+			id,
+			[=](bool success) {
+				if (success) {
+					_helper.complete_add_view(invocation);
+					return;
+				}
+				invocation.return_gerror(MethodError());
+				GLib::idle_add_once([=] {
+					_views.remove(id);
+				});
+			});
+		return true;
+	});
+
+	_helper.signal_handle_remove_view().connect([=](
+			Helper,
+			Gio::DBusMethodInvocation invocation,
+			std::uint64_t id) {
+		_dbusObjectManager.unexport(ViewObjectPath(kHelperObjectPath, id));
+		_views.remove(id);
+		_helper.complete_remove_view(invocation);
+		return true;
+	});
+}
+
+// Same as exec() does for the first view, except that the process is
+// already running and its master object is known to exist.
+void Instance::exportView(
+		Gio::DBusConnection connection,
+		Gio::DBusObjectManagerServer manager,
+		Platform platform,
+		std::uint64_t id,
+		Fn<void(bool)> done) {
+	_platform = platform;
+	_dbusObjectManager = manager;
+	_helper = HelperSkeleton::new_();
+	auto object = ObjectSkeleton::new_(ViewObjectPath(kHelperObjectPath, id));
+	object.set_helper(_helper);
+	_dbusObjectManager.export_(object);
+	registerHelperMethodHandlers();
+
+	MasterProxy::new_(
+		connection,
+		Gio::DBusProxyFlags::NONE_,
+		ViewObjectPath(kMasterObjectPath, id),
+		crl::guard(this, [=](
+				GObjectCpp::Object source_object,
+				Gio::AsyncResult res) {
+			auto master = MasterProxy::new_finish(res);
+			if (!master) {
+				g_critical("%s", master.error().message_().c_str());
+				done(false);
+				return;
+			}
+			_master = *master;
+			_master.signal_data_server_started().connect([=](
+					Master,
+					const std::string &host,
+					std::uint16_t port,
+					const std::string &password) {
+				_dataHost = host;
+				_dataPort = port;
+				_dataPassword = password;
+			});
+			done(true);
+		}));
+}
+
 void Instance::registerHelperMethodHandlers() {
 	if (!_helper) {
 		return;
@@ -3064,9 +4817,16 @@ void Instance::registerHelperMethodHandlers() {
 			int initialWidth,
 			int initialHeight,
 			bool allowThirdPartyCookies,
-			const std::string &restrictedOrigin) {
+			const std::string &restrictedOrigin,
+			const std::string &dataProtocol,
+			GLib::Variant allowedSchemes,
+			GLib::Variant allowedPrefixes) {
 		if (create({
 			.opaqueBg = QColor(r, g, b, a),
+			.navigationPolicy = ParseNavigationPolicy(
+				allowedSchemes,
+				allowedPrefixes),
+			.dataProtocolOverride = dataProtocol,
 			.userDataPath = path,
 			.debug = debug,
 			.allowThirdPartyCookies = allowThirdPartyCookies,
@@ -3096,10 +4856,23 @@ void Instance::registerHelperMethodHandlers() {
 		return true;
 	});
 
+	_helper.signal_handle_reset().connect([=](
+			Helper,
+			Gio::DBusMethodInvocation invocation) {
+		destroyView();
+		_helper.complete_reset(invocation);
+		return true;
+	});
+
 	_helper.signal_handle_resolve().connect([=](
 			Helper,
 			Gio::DBusMethodInvocation invocation) {
-		_helper.complete_resolve(invocation, int(resolve()));
+		const auto result = resolve();
+		_helper.complete_resolve(
+			invocation,
+			int(result),
+			(result == ResolveResult::Success) && CustomSchemeResponses(),
+			LoadedPath());
 		return true;
 	});
 
@@ -3212,12 +4985,384 @@ void Instance::registerHelperMethodHandlers() {
 	});
 }
 
+// By now the application and the main context may be gone, so whatever
+// is left wasn't cleared on quit is leaked instead of being stopped.
+HelperPool::~HelperPool() {
+	for (auto &entry : _entries) {
+		[[maybe_unused]] const auto leaked = entry.instance.release();
+	}
+}
+
+// Helpers are stopped while the application is still fully alive.
+void HelperPool::watchQuit() {
+	if (_quitWatched) {
+		return;
+	} else if (const auto app = QCoreApplication::instance()) {
+		_quitWatched = true;
+		QObject::connect(app, &QCoreApplication::aboutToQuit, [=] {
+			clear();
+		});
+	}
+}
+
+void HelperPool::clear() {
+	_size = 0;
+	const auto entries = ::base::take(_entries);
+}
+
+HelperPool &HelperPool::Get() {
+	static HelperPool result;
+	return result;
+}
+
+void HelperPool::setSize(int size) {
+	_size = std::max(size, 0);
+
+	// Destroyed only after the list is consistent, see recycleProcess().
+	auto removed = std::vector<Entry>();
+	while (int(_entries.size()) > _size) {
+		removed.push_back(std::move(_entries.back()));
+		_entries.pop_back();
+	}
+	refill();
+}
+
+std::unique_ptr<Instance> HelperPool::take(WindowMode mode) {
+	_mode = mode;
+
+	auto result = std::unique_ptr<Instance>();
+	const auto i = std::ranges::find_if(_entries, [&](const Entry &entry) {
+		return entry.ready
+			&& (entry.instance->mode() == mode)
+			&& entry.instance->connected();
+	});
+	if (i != end(_entries)) {
+		result = std::move(i->instance);
+		_entries.erase(i);
+	}
+	refill();
+	return result;
+}
+
+bool HelperPool::wants(Platform platform, WindowMode mode) const {
+	return (mode == _mode)
+		&& Poolable(platform, mode)
+		&& (count(mode) < _size);
+}
+
+void HelperPool::recycle(std::unique_ptr<Instance> instance) {
+	prepare(std::move(instance), [](Instance *raw, Fn<void(bool)> done) {
+		raw->resetProcess(std::move(done));
+	});
+}
+
+void HelperPool::refill() {
+	// Helpers for a mode not asked for anymore would never be taken.
+	auto removed = std::vector<Entry>();
+	for (auto i = begin(_entries); i != end(_entries);) {
+		if ((i->instance->mode() != _mode)
+			|| (i->ready && !i->instance->connected())) {
+			removed.push_back(std::move(*i));
+			i = _entries.erase(i);
+		} else {
+			++i;
+		}
+	}
+	if (!Poolable(DefaultPlatform(_mode), _mode)) {
+		return;
+	}
+	while (count(_mode) < _size) {
+		prepare(
+			std::make_unique<Instance>(true, _mode, false),
+			[](Instance *raw, Fn<void(bool)> done) {
+				raw->warmUp(std::move(done));
+			});
+	}
+}
+
+void HelperPool::prepare(
+		std::unique_ptr<Instance> instance,
+		Fn<void(Instance*, Fn<void(bool)>)> start) {
+	watchQuit();
+	const auto raw = instance.get();
+	const auto id = ++_autoincrement;
+	_entries.push_back({ .instance = std::move(instance), .id = id });
+	start(raw, [=](bool success) {
+		// Let the instance leave its own callbacks before destroying it.
+		crl::on_main([=] {
+			finished(id, success);
+		});
+	});
+}
+
+void HelperPool::finished(std::uint64_t id, bool success) {
+	const auto i = std::ranges::find(_entries, id, &Entry::id);
+	if (i == end(_entries)) {
+		return;
+	} else if (success) {
+		i->ready = true;
+		return;
+	}
+	const auto removed = std::move(i->instance);
+	_entries.erase(i);
+}
+
+int HelperPool::count(WindowMode mode) const {
+	return std::ranges::count_if(_entries, [&](const Entry &entry) {
+		return (entry.instance->mode() == mode);
+	});
+}
+
+[[nodiscard]] std::vector<std::weak_ptr<SharedProcess>> &SharedProcesses() {
+	static auto result = std::vector<std::weak_ptr<SharedProcess>>();
+	return result;
+}
+
+SharedProcess::~SharedProcess() {
+	if (server) {
+		server.stop();
+	}
+	if (process) {
+		process.send_signal(SIGTERM);
+	}
+}
+
+std::shared_ptr<SharedProcess> SharedProcess::Find(
+		WindowMode mode,
+		const std::string &group) {
+	auto &list = SharedProcesses();
+	std::erase_if(list, [](const std::weak_ptr<SharedProcess> &weak) {
+		return weak.expired();
+	});
+	for (const auto &weak : list) {
+		const auto strong = weak.lock();
+		if (strong
+			&& strong->connected
+			&& (strong->mode == mode)
+			&& (strong->group == group)) {
+			return strong;
+		}
+	}
+	return nullptr;
+}
+
+void SharedProcess::Register(const std::shared_ptr<SharedProcess> &process) {
+	const auto weak = std::weak_ptr<SharedProcess>(process);
+	process->connection.signal_closed().connect([=](
+			Gio::DBusConnection,
+			bool remotePeerVanished,
+			GLib::Error_Ref error) {
+		if (const auto strong = weak.lock()) {
+			strong->connected = false;
+		}
+	});
+	SharedProcesses().push_back(weak);
+}
+
+// What Availability() and HiddenSupported() are computed from.
+struct Probe {
+	ResolveResult resolved = ResolveResult::IPCFailure;
+	bool customScheme = false;
+	Platform platform = Platform::Any;
+	std::string library;
+	qint64 modified = 0;
+};
+
+// Each probe spawns a helper process, so it is done once per process.
+// With a cache path set the results are kept on disk, and while the same
+// WebKitGTK file is there, they're used right away and the probes are
+// repeated in the background to catch changes the file time doesn't show.
+struct ProbeCache {
+	QString path;
+	std::optional<Probe> available;
+	std::optional<Probe> hidden;
+	bool loaded = false;
+	bool refreshing = false;
+};
+
+[[nodiscard]] ProbeCache &Probes() {
+	static ProbeCache result;
+	return result;
+}
+
+[[nodiscard]] qint64 LibraryModified(const std::string &library) {
+	const auto info = QFileInfo(QString::fromStdString(library));
+	return (!library.empty() && info.exists())
+		? info.lastModified().toMSecsSinceEpoch()
+		: 0;
+}
+
+[[nodiscard]] Probe MakeProbe(
+		Instance &instance,
+		WindowMode mode,
+		ResolveResult resolved) {
+	auto result = Probe{
+		.resolved = resolved,
+		.customScheme = (mode != WindowMode::Hidden)
+			&& (resolved == ResolveResult::Success)
+			&& (instance.dataSchemeSupported()
+				|| instance.startDataServer()),
+		.platform = DefaultPlatform(mode),
+		.library = instance.library(),
+	};
+	result.modified = LibraryModified(result.library);
+	return result;
+}
+
+[[nodiscard]] Probe ProbeNow(WindowMode mode) {
+	Instance instance(true, mode);
+	return MakeProbe(instance, mode, instance.resolve());
+}
+
+void ProbeAsync(WindowMode mode, Fn<void(Probe)> done) {
+	const auto instance = std::make_shared<std::unique_ptr<Instance>>(
+		std::make_unique<Instance>(true, mode, false));
+	const auto raw = instance->get();
+	raw->startProcess([=] {
+		raw->resolve([=](ResolveResult resolved) {
+			done(MakeProbe(*raw, mode, resolved));
+			crl::on_main([=] {
+				instance->reset();
+			});
+		});
+	});
+}
+
+[[nodiscard]] QJsonObject SerializeProbe(const Probe &probe) {
+	auto result = QJsonObject();
+	result.insert(u"resolved"_q, int(probe.resolved));
+	result.insert(u"customScheme"_q, probe.customScheme);
+	result.insert(u"platform"_q, int(probe.platform));
+	result.insert(u"library"_q, QString::fromStdString(probe.library));
+	result.insert(u"modified"_q, double(probe.modified));
+	return result;
+}
+
+[[nodiscard]] std::optional<Probe> DeserializeProbe(
+		const QJsonValue &value,
+		WindowMode mode) {
+	const auto object = value.toObject();
+	auto result = Probe{
+		.resolved = ResolveResult(object.value(u"resolved"_q).toInt(-1)),
+		.customScheme = object.value(u"customScheme"_q).toBool(),
+		.platform = Platform(object.value(u"platform"_q).toInt(-1)),
+		.library = object.value(u"library"_q).toString().toStdString(),
+		.modified = qint64(object.value(u"modified"_q).toDouble()),
+	};
+	if (result.library.empty()
+		|| (result.platform != DefaultPlatform(mode))
+		|| (result.modified != LibraryModified(result.library))
+		|| (result.resolved != ResolveResult::Success
+			&& result.resolved != ResolveResult::CantInit)) {
+		return std::nullopt;
+	}
+	return result;
+}
+
+void SaveProbes() {
+	const auto &probes = Probes();
+	if (probes.path.isEmpty()) {
+		return;
+	}
+	auto object = QJsonObject();
+	const auto add = [&](
+			const QString &key,
+			const std::optional<Probe> &probe) {
+		if (probe && !probe->library.empty()) {
+			object.insert(key, SerializeProbe(*probe));
+		}
+	};
+	add(u"available"_q, probes.available);
+	add(u"hidden"_q, probes.hidden);
+
+	const auto serialized = QJsonDocument(object).toJson(
+		QJsonDocument::Compact);
+	auto file = QSaveFile(probes.path);
+	if (!file.open(QIODevice::WriteOnly)
+		|| file.write(serialized) != serialized.size()
+		|| !file.commit()) {
+		LOG(("WebView Error: Could not write %1.").arg(probes.path));
+	}
+}
+
+// A probe failing to talk to the helper says nothing about the library.
+void StoreProbe(std::optional<Probe> &to, Probe probe) {
+	if (probe.resolved != ResolveResult::IPCFailure) {
+		to = std::move(probe);
+		SaveProbes();
+	}
+}
+
+void RefreshProbes() {
+	auto &probes = Probes();
+	if (probes.refreshing) {
+		return;
+	}
+	probes.refreshing = true;
+	const auto refreshHidden = [] {
+		if (!Probes().hidden) {
+			Probes().refreshing = false;
+			return;
+		}
+		ProbeAsync(WindowMode::Hidden, [](Probe probe) {
+			StoreProbe(Probes().hidden, std::move(probe));
+			Probes().refreshing = false;
+		});
+	};
+	if (!probes.available) {
+		refreshHidden();
+		return;
+	}
+	ProbeAsync(WindowMode::Embedded, [=](Probe probe) {
+		StoreProbe(Probes().available, std::move(probe));
+		refreshHidden();
+	});
+}
+
+void LoadProbes() {
+	auto &probes = Probes();
+	if (probes.loaded || probes.path.isEmpty()) {
+		return;
+	}
+	probes.loaded = true;
+
+	auto file = QFile(probes.path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	const auto object = QJsonDocument::fromJson(file.readAll()).object();
+	auto loaded = false;
+	if (!probes.available) {
+		probes.available = DeserializeProbe(
+			object.value(u"available"_q),
+			WindowMode::Embedded);
+		loaded |= probes.available.has_value();
+	}
+	if (!probes.hidden) {
+		probes.hidden = DeserializeProbe(
+			object.value(u"hidden"_q),
+			WindowMode::Hidden);
+		loaded |= probes.hidden.has_value();
+	}
+	if (loaded) {
+		RefreshProbes();
+	}
+}
+
 } // namespace
 
 Available Availability() {
-	Instance instance;
-	const auto resolved = instance.resolve();
-	if (resolved == ResolveResult::NoLibrary) {
+	auto &probes = Probes();
+	LoadProbes();
+	if (!probes.available) {
+		auto probe = ProbeNow(WindowMode::Embedded);
+		if (probe.resolved == ResolveResult::IPCFailure) {
+			return Available();
+		}
+		StoreProbe(probes.available, std::move(probe));
+	}
+	const auto &probe = *probes.available;
+	if (probe.resolved == ResolveResult::NoLibrary) {
 		return Available{
 			.error = Available::Error::NoWebKitGTK,
 			.details = "Please install WebKitGTK "
@@ -3225,8 +5370,8 @@ Available Availability() {
 			"from your package manager.",
 		};
 	}
-	const auto success = (resolved == ResolveResult::Success)
-		&& instance.startDataServer();
+	const auto success = (probe.resolved == ResolveResult::Success)
+		&& probe.customScheme;
 	return Available{
 		.customSchemeRequests = success,
 		.customRangeRequests = success,
@@ -3235,18 +5380,83 @@ Available Availability() {
 }
 
 bool HiddenSupported() {
-	Instance instance(true, WindowMode::Hidden);
-	return instance.resolve() == ResolveResult::Success;
+	auto &probes = Probes();
+	LoadProbes();
+	if (!probes.hidden) {
+		auto probe = ProbeNow(WindowMode::Hidden);
+		if (probe.resolved == ResolveResult::IPCFailure) {
+			return false;
+		}
+		StoreProbe(probes.hidden, std::move(probe));
+	}
+	return (probes.hidden->resolved == ResolveResult::Success);
 }
 
 std::unique_ptr<Interface> CreateInstance(Config config) {
-	auto result = std::make_unique<Instance>(true, config.mode);
+	auto result = std::unique_ptr<Instance>();
+	if (const auto group = SharingGroup(config)) {
+		result = std::make_unique<Instance>(true, config.mode, false);
+		auto started = false;
+		result->startShared(*group, [&] {
+			started = true;
+			GLib::MainContext::default_().wakeup();
+		});
+		while (!started) {
+			GLib::MainContext::default_().iteration(true);
+		}
+	} else {
+		result = HelperPool::Get().take(config.mode);
+	}
+	if (!result) {
+		result = std::make_unique<Instance>(true, config.mode);
+	}
 	if (!result->create(std::move(config))) {
 		return nullptr;
 	}
 	return result;
 }
 
+void CreateInstanceAsync(
+		Config config,
+		Fn<void(std::unique_ptr<Interface>)> done) {
+	const auto group = SharingGroup(config);
+	auto pooled = group
+		? std::unique_ptr<Instance>()
+		: HelperPool::Get().take(config.mode);
+	const auto started = (pooled != nullptr);
+	const auto instance = std::make_shared<std::unique_ptr<Instance>>(
+		started
+			? std::move(pooled)
+			: std::make_unique<Instance>(true, config.mode, false));
+	const auto raw = instance->get();
+	auto create = [=, config = std::move(config)]() mutable {
+		raw->create(std::move(config), [=](bool success) {
+			// Let the instance leave its own callbacks before handing it out.
+			crl::on_main([=] {
+				auto result = ::base::take(*instance);
+				done(success ? std::move(result) : nullptr);
+			});
+		});
+	};
+	if (started) {
+		create();
+	} else if (group) {
+		raw->startShared(*group, std::move(create));
+	} else {
+		raw->startProcess(std::move(create));
+	}
+}
+
+void SetHelperPoolSize(int size) {
+	HelperPool::Get().setSize(size);
+}
+
+void SetAvailabilityCachePath(const std::string &path) {
+	auto &probes = Probes();
+	probes.path = QString::fromStdString(path);
+	probes.loaded = false;
+}
+
 int Exec() {
 	return Instance(false).exec();
 }
@@ -13,6 +13,11 @@ namespace Webview::WebKitGTK {
 [[nodiscard]] Available Availability();
 [[nodiscard]] bool HiddenSupported();
 [[nodiscard]] std::unique_ptr<Interface> CreateInstance(Config config);
+void CreateInstanceAsync(
+	Config config,
+	Fn<void(std::unique_ptr<Interface>)> done);
+void SetHelperPoolSize(int size);
+void SetAvailabilityCachePath(const std::string &path);
 
 int Exec();
 void SetSocketPath(const std::string &socketPath);
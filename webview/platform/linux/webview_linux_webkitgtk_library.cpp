@@ -8,6 +8,8 @@
 
 #include "base/platform/linux/base_linux_library.h"
 
+#include <dlfcn.h>
+
 namespace Webview::WebKitGTK::Library {
 
 ResolveResult Resolve(Platform platform, WindowMode mode) {
@@ -58,6 +60,7 @@ ResolveResult Resolve(Platform platform, WindowMode mode) {
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_navigation_action_get_request)
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_uri_request_get_uri)
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_policy_decision_ignore)
+		&& LOAD_LIBRARY_SYMBOL(lib, webkit_policy_decision_use)
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_script_dialog_get_dialog_type)
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_script_dialog_get_message)
 		&& LOAD_LIBRARY_SYMBOL(lib, webkit_script_dialog_confirm_set_confirmed)
@@ -161,6 +164,26 @@ ResolveResult Resolve(Platform platform, WindowMode mode) {
 	LOAD_LIBRARY_SYMBOL(lib, webkit_clipboard_permission_request_get_type);
 	LOAD_LIBRARY_SYMBOL(lib, webkit_permission_request_deny);
 
+	// Since 2.36, the request headers and the response object are needed
+	// to answer range requests, soup is resolved through WebKit's deps.
+	LOAD_LIBRARY_SYMBOL(lib, webkit_web_view_get_context);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_web_context_register_uri_scheme);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_web_context_get_security_manager);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_security_manager_register_uri_scheme_as_secure);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_security_manager_register_uri_scheme_as_cors_enabled);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_request_get_uri);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_request_get_http_headers);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_request_get_web_view);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_request_finish_error);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_request_finish_with_response);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_response_new);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_response_set_status);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_response_set_content_type);
+	LOAD_LIBRARY_SYMBOL(lib, webkit_uri_scheme_response_set_http_headers);
+	LOAD_LIBRARY_SYMBOL(lib, soup_message_headers_new);
+	LOAD_LIBRARY_SYMBOL(lib, soup_message_headers_append);
+	LOAD_LIBRARY_SYMBOL(lib, soup_message_headers_get_one);
+
 	if (gtk_native_get_surface) {
 		LOAD_LIBRARY_SYMBOL(lib, gdk_wayland_toplevel_export_handle);
 		LOAD_LIBRARY_SYMBOL(lib, gdk_wayland_toplevel_drop_exported_handle);
@@ -188,4 +211,29 @@ ResolveResult Resolve(Platform platform, WindowMode mode) {
 		: ResolveResult::CantInit;
 }
 
+bool CustomSchemeResponses() {
+	return webkit_web_view_get_context
+		&& webkit_web_context_register_uri_scheme
+		&& webkit_uri_scheme_request_get_uri
+		&& webkit_uri_scheme_request_get_http_headers
+		&& webkit_uri_scheme_request_get_web_view
+		&& webkit_uri_scheme_request_finish_error
+		&& webkit_uri_scheme_request_finish_with_response
+		&& webkit_uri_scheme_response_new
+		&& webkit_uri_scheme_response_set_status
+		&& webkit_uri_scheme_response_set_content_type
+		&& webkit_uri_scheme_response_set_http_headers
+		&& soup_message_headers_new
+		&& soup_message_headers_append
+		&& soup_message_headers_get_one;
+}
+
+std::string LoadedPath() {
+	auto info = Dl_info();
+	const auto symbol = reinterpret_cast<void*>(webkit_web_view_get_type);
+	return (symbol && dladdr(symbol, &info) && info.dli_fname)
+		? std::string(info.dli_fname)
+		: std::string();
+}
+
 } // namespace Webview::WebKitGTK::Library
@@ -10,6 +10,8 @@
 
 #include <gio/gio.h>
 
+#include <string>
+
 #define GDK_CURRENT_TIME 0L 
 
 #define GTK_TYPE_CONTAINER (gtk_container_get_type ())
@@ -130,6 +132,13 @@ typedef struct _WebKitDownload WebKitDownload;
 typedef struct _WebKitAuthenticationRequest WebKitAuthenticationRequest;
 typedef struct _WebKitCredential WebKitCredential;
 typedef struct _WebKitPermissionRequest WebKitPermissionRequest;
+typedef struct _WebKitSecurityManager WebKitSecurityManager;
+typedef struct _WebKitURISchemeRequest WebKitURISchemeRequest;
+typedef struct _WebKitURISchemeResponse WebKitURISchemeResponse;
+typedef struct _SoupMessageHeaders SoupMessageHeaders;
+typedef void (*WebKitURISchemeRequestCallback)(
+	WebKitURISchemeRequest *request,
+	gpointer user_data);
 
 typedef enum {
 	GTK_WINDOW_TOPLEVEL,
@@ -214,6 +223,12 @@ typedef enum {
 	WEBKIT_COOKIE_POLICY_ACCEPT_NO_THIRD_PARTY,
 } WebKitCookieAcceptPolicy;
 
+typedef enum {
+	SOUP_MESSAGE_HEADERS_REQUEST,
+	SOUP_MESSAGE_HEADERS_RESPONSE,
+	SOUP_MESSAGE_HEADERS_MULTIPART,
+} SoupMessageHeadersType;
+
 namespace Webview::WebKitGTK::Library {
 
 inline gboolean (*gtk_init_check)(int *argc, char ***argv);
@@ -407,6 +422,7 @@ inline WebKitURIRequest *(*webkit_navigation_action_get_request)(
 	WebKitNavigationAction *navigation);
 inline const gchar *(*webkit_uri_request_get_uri)(WebKitURIRequest *request);
 inline void (*webkit_policy_decision_ignore)(WebKitPolicyDecision *decision);
+inline void (*webkit_policy_decision_use)(WebKitPolicyDecision *decision);
 
 inline WebKitScriptDialogType (*webkit_script_dialog_get_dialog_type)(
 	WebKitScriptDialog *dialog);
@@ -566,6 +582,56 @@ inline void (*webkit_credential_free)(WebKitCredential *credential);
 inline GType (*webkit_clipboard_permission_request_get_type)(void);
 inline void (*webkit_permission_request_deny)(
 	WebKitPermissionRequest *request);
+inline WebKitWebContext *(*webkit_web_view_get_context)(
+	WebKitWebView *web_view);
+inline void (*webkit_web_context_register_uri_scheme)(
+	WebKitWebContext *context,
+	const gchar *scheme,
+	WebKitURISchemeRequestCallback callback,
+	gpointer user_data,
+	GDestroyNotify user_data_destroy_func);
+inline WebKitSecurityManager *(*webkit_web_context_get_security_manager)(
+	WebKitWebContext *context);
+inline void (*webkit_security_manager_register_uri_scheme_as_secure)(
+	WebKitSecurityManager *security_manager,
+	const gchar *scheme);
+inline void (*webkit_security_manager_register_uri_scheme_as_cors_enabled)(
+	WebKitSecurityManager *security_manager,
+	const gchar *scheme);
+inline const gchar *(*webkit_uri_scheme_request_get_uri)(
+	WebKitURISchemeRequest *request);
+inline SoupMessageHeaders *(*webkit_uri_scheme_request_get_http_headers)(
+	WebKitURISchemeRequest *request);
+inline WebKitWebView *(*webkit_uri_scheme_request_get_web_view)(
+	WebKitURISchemeRequest *request);
+inline void (*webkit_uri_scheme_request_finish_error)(
+	WebKitURISchemeRequest *request,
+	GError *error);
+inline void (*webkit_uri_scheme_request_finish_with_response)(
+	WebKitURISchemeRequest *request,
+	WebKitURISchemeResponse *response);
+inline WebKitURISchemeResponse *(*webkit_uri_scheme_response_new)(
+	GInputStream *input_stream,
+	gint64 stream_length);
+inline void (*webkit_uri_scheme_response_set_status)(
+	WebKitURISchemeResponse *response,
+	guint status_code,
+	const gchar *reason_phrase);
+inline void (*webkit_uri_scheme_response_set_content_type)(
+	WebKitURISchemeResponse *response,
+	const gchar *content_type);
+inline void (*webkit_uri_scheme_response_set_http_headers)(
+	WebKitURISchemeResponse *response,
+	SoupMessageHeaders *headers);
+inline SoupMessageHeaders *(*soup_message_headers_new)(
+	SoupMessageHeadersType type);
+inline void (*soup_message_headers_append)(
+	SoupMessageHeaders *hdrs,
+	const char *name,
+	const char *value);
+inline const char *(*soup_message_headers_get_one)(
+	SoupMessageHeaders *hdrs,
+	const char *name);
 
 enum class ResolveResult {
 	Success,
@@ -584,4 +650,11 @@ enum class Platform {
 	Platform platform,
 	WindowMode mode);
 
+// Custom scheme responses with a status and headers, since 2.36.
+// Without them the data server over loopback TCP is used instead.
+[[nodiscard]] bool CustomSchemeResponses();
+
+// File the resolved WebKitGTK was loaded from, empty if it wasn't.
+[[nodiscard]] std::string LoadedPath();
+
 } // namespace Webview::WebKitGTK::Library
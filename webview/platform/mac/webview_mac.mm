@@ -1203,6 +1203,18 @@ std::unique_ptr<Interface> CreateInstance(Config config) {
 	return std::make_unique<Instance>(std::move(config));
 }
 
+void CreateInstanceAsync(
+		Config config,
+		Fn<void(std::unique_ptr<Interface>)> done) {
+	done(CreateInstance(std::move(config)));
+}
+
+void SetHelperPoolSize(int) {
+}
+
+void SetAvailabilityCachePath(const std::string &) {
+}
+
 std::string GenerateStorageToken() {
 	return UuidToToken([NSUUID UUID]);
 }
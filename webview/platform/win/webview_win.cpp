@@ -74,6 +74,18 @@ std::unique_ptr<Interface> CreateInstance(Config config) {
 	return EdgeHtml::CreateInstance(config);
 }
 
+void CreateInstanceAsync(
+		Config config,
+		Fn<void(std::unique_ptr<Interface>)> done) {
+	done(CreateInstance(std::move(config)));
+}
+
+void SetHelperPoolSize(int) {
+}
+
+void SetAvailabilityCachePath(const std::string &) {
+}
+
 std::string GenerateStorageToken() {
 	constexpr auto kSize = 16;
 	auto result = std::string(kSize, ' ');
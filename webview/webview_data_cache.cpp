@@ -0,0 +1,102 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_cache.h"
+
+#include "webview/webview_data_stream_memory.h"
+
+namespace Webview {
+
+DataCache::DataCache(std::int64_t limit)
+: _limit(limit) {
+}
+
+std::optional<DataResponse> DataCache::find(
+		const std::string &id,
+		std::int64_t offset) {
+	auto i = _entries.upper_bound(Key{ id, offset });
+	if (i == begin(_entries)
+		|| (--i)->first.id != id
+		|| i->first.offset + i->second.bytes.size() <= offset) {
+		++_misses;
+		return std::nullopt;
+	}
+	++_hits;
+
+	auto &entry = i->second;
+	_lru.splice(end(_lru), _lru, entry.lru);
+
+	return DataResponse{
+		.stream = std::make_unique<DataStreamFromMemory>(
+			entry.bytes,
+			entry.mime),
+		.streamOffset = i->first.offset,
+		.totalSize = entry.total,
+		.freshness = entry.freshness,
+	};
+}
+
+void DataCache::put(const std::string &id, const DataResponse &response) {
+	const auto memory = dynamic_cast<DataStreamFromMemory*>(
+		response.stream.get());
+	if (!memory) {
+		return;
+	}
+	auto bytes = memory->data();
+	if (bytes.isEmpty() || bytes.size() > _limit) {
+		return;
+	}
+	auto key = Key{ id, response.streamOffset };
+	if (_entries.contains(key)) {
+		remove(key);
+	}
+	_size += bytes.size();
+	const auto lru = _lru.insert(end(_lru), key);
+	_entries.emplace(std::move(key), Entry{
+		.bytes = std::move(bytes),
+		.mime = memory->mime(),
+		.total = response.totalSize,
+		.freshness = response.freshness,
+		.lru = lru,
+	});
+	prune();
+}
+
+void DataCache::invalidate(const std::string &id) {
+	auto i = _entries.lower_bound(Key{ id, 0 });
+	while (i != end(_entries) && i->first.id == id) {
+		Assert(_size >= i->second.bytes.size());
+		_size -= i->second.bytes.size();
+		_lru.erase(i->second.lru);
+		i = _entries.erase(i);
+	}
+}
+
+DataCacheStats DataCache::stats() const {
+	return {
+		.hits = _hits,
+		.misses = _misses,
+		.size = _size,
+	};
+}
+
+void DataCache::remove(const Key &key) {
+	const auto i = _entries.find(key);
+	Assert(i != end(_entries));
+	Assert(_size >= i->second.bytes.size());
+	_size -= i->second.bytes.size();
+	_lru.erase(i->second.lru);
+	_entries.erase(i);
+}
+
+void DataCache::prune() {
+	while (_size > _limit) {
+		Assert(!_lru.empty());
+		remove(_lru.front());
+	}
+}
+
+} // namespace Webview
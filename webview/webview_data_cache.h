@@ -0,0 +1,65 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "base/basic_types.h"
+#include "base/flat_map.h"
+#include "webview/webview_interface.h"
+
+#include <QtCore/QByteArray>
+
+#include <list>
+
+namespace Webview {
+
+// Keeps the parts returned by the data request handler, so that repeated
+// range requests (like seeking in a video) are answered without calling
+// the handler again. Only in-memory streams are kept, they're shared
+// with the cache without copying the bytes.
+class DataCache final {
+public:
+	explicit DataCache(std::int64_t limit);
+
+	[[nodiscard]] std::optional<DataResponse> find(
+		const std::string &id,
+		std::int64_t offset);
+	void put(const std::string &id, const DataResponse &response);
+
+	// Drops all the parts of the resource, when it was replaced.
+	void invalidate(const std::string &id);
+
+	[[nodiscard]] DataCacheStats stats() const;
+
+private:
+	struct Key {
+		std::string id;
+		std::int64_t offset = 0;
+
+		friend inline auto operator<=>(const Key&, const Key&) = default;
+		friend inline bool operator==(const Key&, const Key&) = default;
+	};
+	struct Entry {
+		QByteArray bytes;
+		std::string mime;
+		std::int64_t total = 0;
+		DataFreshness freshness;
+		std::list<Key>::iterator lru;
+	};
+
+	void remove(const Key &key);
+	void prune();
+
+	const std::int64_t _limit = 0;
+	::base::flat_map<Key, Entry> _entries;
+	std::list<Key> _lru; // Least recently used first.
+	int64 _size = 0;
+	int64 _hits = 0;
+	int64 _misses = 0;
+
+};
+
+} // namespace Webview
@@ -0,0 +1,151 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_metrics.h"
+
+#include "base/flat_map.h"
+
+#include <crl/crl.h>
+
+#include <chrono>
+#include <mutex>
+
+namespace Webview {
+namespace {
+
+// Idle resources are forgotten when there are more than that.
+constexpr auto kMaxResources = 256;
+
+[[nodiscard]] std::int64_t Now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Accumulate(DataResourceMetrics &to, const DataRequestMetrics &from) {
+	++to.requests;
+	to.bytes += from.bytes;
+	to.stalls += from.stalls;
+	to.queueTime += from.queueTime;
+	to.handlerTime += from.handlerTime;
+	to.firstByteTime += from.firstByteTime;
+	to.maxFirstByteTime = std::max(to.maxFirstByteTime, from.firstByteTime);
+	--to.connections;
+}
+
+void Connect(DataResourceMetrics &to) {
+	to.maxConnections = std::max(to.maxConnections, ++to.connections);
+}
+
+} // namespace
+
+struct DataMetricsState {
+	std::mutex mutex;
+	DataResourceMetrics total;
+	::base::flat_map<std::string, DataResourceMetrics> resources;
+	Fn<void(DataRequestMetrics)> report;
+};
+
+DataMetricsTrace::DataMetricsTrace(
+	std::shared_ptr<DataMetricsState> state,
+	std::string id,
+	std::int64_t offset)
+: _state(std::move(state))
+, _metrics{ .id = std::move(id), .offset = offset }
+, _received(Now()) {
+	auto lock = std::lock_guard(_state->mutex);
+	auto &resources = _state->resources;
+	if (!resources.contains(_metrics.id)
+		&& int(resources.size()) >= kMaxResources) {
+		const auto idle = std::ranges::find_if(resources, [](
+				const auto &pair) {
+			return !pair.second.connections;
+		});
+		if (idle != end(resources)) {
+			resources.erase(idle);
+		}
+	}
+	auto &resource = resources[_metrics.id];
+	resource.id = _metrics.id;
+	Connect(resource);
+	Connect(_state->total);
+}
+
+DataMetricsTrace::~DataMetricsTrace() {
+	_metrics.totalTime = Now() - _received;
+
+	auto lock = std::lock_guard(_state->mutex);
+	Accumulate(_state->total, _metrics);
+	const auto i = _state->resources.find(_metrics.id);
+	if (i != end(_state->resources)) {
+		Accumulate(i->second, _metrics);
+	}
+	if (_state->report) {
+		_state->report(std::move(_metrics));
+	}
+}
+
+void DataMetricsTrace::started() {
+	_started = Now();
+	_metrics.queueTime = _started - _received;
+}
+
+// Only the first response is the handler latency, the continuation parts
+// are requested while the previous ones are being written.
+void DataMetricsTrace::resolved() {
+	if (!_resolved) {
+		_resolved = true;
+		_metrics.handlerTime = Now() - (_started ? _started : _received);
+	}
+}
+
+void DataMetricsTrace::responded(int status) {
+	_metrics.status = status;
+	_metrics.firstByteTime = Now() - _received;
+}
+
+void DataMetricsTrace::sent(std::int64_t bytes) {
+	_metrics.bytes += bytes;
+}
+
+void DataMetricsTrace::stalled() {
+	++_metrics.stalls;
+}
+
+DataMetricsCollector::DataMetricsCollector()
+: _state(std::make_shared<DataMetricsState>()) {
+	_state->report = [=](DataRequestMetrics metrics) {
+		crl::on_main(this, [=, metrics = std::move(metrics)] {
+			_requests.fire_copy(metrics);
+		});
+	};
+}
+
+DataMetricsCollector::~DataMetricsCollector() {
+	auto lock = std::lock_guard(_state->mutex);
+	_state->report = nullptr;
+}
+
+std::shared_ptr<DataMetricsTrace> DataMetricsCollector::trace(
+		std::string id,
+		std::int64_t offset) {
+	return std::make_shared<DataMetricsTrace>(_state, std::move(id), offset);
+}
+
+DataMetrics DataMetricsCollector::snapshot() const {
+	auto lock = std::lock_guard(_state->mutex);
+	auto result = DataMetrics{ .total = _state->total };
+	result.resources.reserve(_state->resources.size());
+	for (const auto &[id, resource] : _state->resources) {
+		result.resources.push_back(resource);
+	}
+	return result;
+}
+
+rpl::producer<DataRequestMetrics> DataMetricsCollector::requests() const {
+	return _requests.events();
+}
+
+} // namespace Webview
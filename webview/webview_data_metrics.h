@@ -0,0 +1,64 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "base/basic_types.h"
+#include "base/weak_ptr.h"
+#include "webview/webview_interface.h"
+
+#include <rpl/event_stream.h>
+
+namespace Webview {
+
+struct DataMetricsState;
+
+// Timings of one request, accounted when the last reference is released.
+// Each step is marked on the thread that takes it, one after another.
+class DataMetricsTrace final {
+public:
+	DataMetricsTrace(
+		std::shared_ptr<DataMetricsState> state,
+		std::string id,
+		std::int64_t offset);
+	~DataMetricsTrace();
+
+	void started();
+	void resolved();
+	void responded(int status);
+	void sent(std::int64_t bytes);
+	void stalled();
+
+private:
+	const std::shared_ptr<DataMetricsState> _state;
+	DataRequestMetrics _metrics;
+	std::int64_t _received = 0;
+	std::int64_t _started = 0;
+	bool _resolved = false;
+
+};
+
+// Traces may be created and released on any thread, while snapshot()
+// and requests() are used on the main one.
+class DataMetricsCollector final : public ::base::has_weak_ptr {
+public:
+	DataMetricsCollector();
+	~DataMetricsCollector();
+
+	[[nodiscard]] std::shared_ptr<DataMetricsTrace> trace(
+		std::string id,
+		std::int64_t offset);
+
+	[[nodiscard]] DataMetrics snapshot() const;
+	[[nodiscard]] rpl::producer<DataRequestMetrics> requests() const;
+
+private:
+	const std::shared_ptr<DataMetricsState> _state;
+	rpl::event_stream<DataRequestMetrics> _requests;
+
+};
+
+} // namespace Webview
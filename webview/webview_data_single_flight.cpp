@@ -0,0 +1,163 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_single_flight.h"
+
+#include "webview/webview_data_stream_file.h"
+#include "webview/webview_data_stream_mapped.h"
+#include "webview/webview_data_stream_memory.h"
+
+#include <crl/crl.h>
+
+#include <algorithm>
+
+namespace Webview {
+namespace {
+
+// Only the streams which can be read independently without copying.
+[[nodiscard]] std::unique_ptr<DataStream> ShareStream(DataStream *stream) {
+	if (const auto memory = dynamic_cast<DataStreamFromMemory*>(stream)) {
+		return std::make_unique<DataStreamFromMemory>(
+			memory->data(),
+			memory->mime());
+	} else if (const auto mapped = dynamic_cast<DataStreamFromMappedFile*>(
+			stream)) {
+		auto result = std::make_unique<DataStreamFromMappedFile>(
+			mapped->path(),
+			mapped->mime());
+		return result->valid() ? std::move(result) : nullptr;
+	} else if (const auto file = dynamic_cast<DataStreamFromFile*>(stream)) {
+		auto result = std::make_unique<DataStreamFromFile>(
+			file->path(),
+			file->mime());
+		return result->valid() ? std::move(result) : nullptr;
+	}
+	return nullptr;
+}
+
+// Calls `dropped` if the last copy of the callback holding it is destroyed
+// without being called, like when the handler gives up on the request.
+class DoneGuard final {
+public:
+	explicit DoneGuard(Fn<void()> dropped) : _dropped(std::move(dropped)) {
+	}
+	~DoneGuard() {
+		if (_dropped) {
+			_dropped();
+		}
+	}
+
+	void called() {
+		_dropped = nullptr;
+	}
+
+private:
+	Fn<void()> _dropped;
+
+};
+
+} // namespace
+
+DataSingleFlight::DataSingleFlight(Fn<DataResult(DataRequest)> handler)
+: _handler(std::move(handler)) {
+}
+
+DataResult DataSingleFlight::request(DataRequest request) {
+	for (auto &flight : _flights) {
+		if (flight.id == request.id
+			&& flight.offset <= request.offset
+			&& (flight.limit <= 0
+				|| request.offset < flight.offset + flight.limit)) {
+			++_coalesced;
+			flight.waiters.push_back(std::move(request));
+			return DataResult::Pending;
+		}
+	}
+	const auto index = ++_autoincrement;
+	auto waiter = DataRequest{
+		.id = request.id,
+		.offset = request.offset,
+		.limit = request.limit,
+		.done = std::move(request.done),
+	};
+	_flights.push_back({
+		.index = index,
+		.id = request.id,
+		.offset = request.offset,
+		.limit = request.limit,
+	});
+	_flights.back().waiters.push_back(std::move(waiter));
+
+	const auto weak = ::base::make_weak(this);
+	const auto guard = std::make_shared<DoneGuard>([=] {
+		// Later, so that a request failed right away is just removed.
+		crl::on_main(weak, [=] {
+			weak->abandon(index);
+		});
+	});
+	request.done = crl::guard(this, [=](DataResponse response) {
+		guard->called();
+		finish(index, std::move(response));
+	});
+	const auto result = _handler(std::move(request));
+	if (result == DataResult::Failed) {
+		const auto i = std::ranges::find(_flights, index, &Flight::index);
+		if (i != end(_flights)) {
+			_flights.erase(i);
+		}
+	}
+	return result;
+}
+
+void DataSingleFlight::finish(uint64 index, DataResponse response) {
+	const auto i = std::ranges::find(_flights, index, &Flight::index);
+	if (i == end(_flights)) {
+		return;
+	}
+	auto waiters = std::move(i->waiters);
+	_flights.erase(i);
+
+	const auto stream = response.stream.get();
+	const auto from = response.streamOffset;
+	const auto till = stream ? (from + stream->size()) : from;
+	const auto weak = ::base::make_weak(this);
+	for (auto k = 1; k < int(waiters.size()); ++k) {
+		auto &waiter = waiters[k];
+		auto shared = (waiter.offset >= from && waiter.offset < till)
+			? ShareStream(stream)
+			: nullptr;
+		if (shared) {
+			waiter.done({
+				.stream = std::move(shared),
+				.streamOffset = response.streamOffset,
+				.totalSize = response.totalSize,
+				.freshness = response.freshness,
+			});
+		} else if (!weak) {
+			return;
+		} else if (request(waiter) == DataResult::Failed) {
+			// An empty response lets the waiter give up on the request.
+			waiter.done({});
+		}
+	}
+	waiters.front().done(std::move(response));
+}
+
+void DataSingleFlight::abandon(uint64 index) {
+	const auto i = std::ranges::find(_flights, index, &Flight::index);
+	if (i == end(_flights)) {
+		return;
+	}
+	auto waiters = std::move(i->waiters);
+	_flights.erase(i);
+
+	// An empty response lets the waiters give up on the request.
+	for (auto &waiter : waiters) {
+		waiter.done({});
+	}
+}
+
+} // namespace Webview
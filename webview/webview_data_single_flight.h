@@ -0,0 +1,48 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "base/basic_types.h"
+#include "base/weak_ptr.h"
+#include "webview/webview_interface.h"
+
+namespace Webview {
+
+// Coalesces concurrent requests for the same part of a resource (like
+// parallel range requests of a media element) into one handler call.
+// The response is shared with every waiter whose offset it contains,
+// the others get their own handler call when it arrives.
+class DataSingleFlight final : public ::base::has_weak_ptr {
+public:
+	explicit DataSingleFlight(Fn<DataResult(DataRequest)> handler);
+
+	DataResult request(DataRequest request);
+
+	[[nodiscard]] int64 coalesced() const {
+		return _coalesced;
+	}
+
+private:
+	struct Flight {
+		uint64 index = 0;
+		std::string id;
+		std::int64_t offset = 0;
+		std::int64_t limit = 0;
+		std::vector<DataRequest> waiters;
+	};
+
+	void finish(uint64 index, DataResponse response);
+	void abandon(uint64 index);
+
+	Fn<DataResult(DataRequest)> _handler;
+	std::vector<Flight> _flights;
+	uint64 _autoincrement = 0;
+	int64 _coalesced = 0;
+
+};
+
+} // namespace Webview
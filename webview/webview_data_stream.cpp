@@ -0,0 +1,25 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_stream.h"
+
+namespace Webview {
+
+void DataStream::next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) {
+	if (requested < 0) {
+		callback({ .size = -1 });
+		return;
+	}
+	if (std::int64_t(_nextBuffer.size()) < requested) {
+		_nextBuffer.resize(requested);
+	}
+	const auto read = this->read(_nextBuffer.data(), requested);
+	callback({ .bytes = _nextBuffer.data(), .size = read });
+}
+
+} // namespace Webview
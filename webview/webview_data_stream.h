@@ -7,10 +7,17 @@
 #pragma once
 
 #include <cinttypes>
+#include <functional>
 #include <string>
 
 namespace Webview {
 
+// Bytes borrowed from the stream, valid till the next call to next().
+struct DataChunk {
+	const char *bytes = nullptr;
+	std::int64_t size = 0; // Zero at the end, negative on error.
+};
+
 class DataStream {
 public:
 	virtual ~DataStream() = default;
@@ -20,6 +27,19 @@ public:
 
 	virtual std::int64_t seek(int origin, std::int64_t position) = 0;
 	virtual std::int64_t read(void *buffer, std::int64_t requested) = 0;
+
+	// Up to `requested` bytes from the current position, which is moved
+	// past them. The callback may be called right away or later, but on
+	// the same thread and only while the stream is alive. Streams that
+	// hold their bytes hand them out without copying, others may produce
+	// them asynchronously, by default they are read() into a buffer.
+	virtual void next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback);
+
+private:
+	std::string _nextBuffer;
+
 };
 
 } // namespace Webview
@@ -0,0 +1,133 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_stream_concat.h"
+
+#include <algorithm>
+
+namespace Webview {
+
+DataStreamConcat::DataStreamConcat(
+	std::vector<std::unique_ptr<DataStream>> parts,
+	std::string mime)
+: _mime(std::move(mime)) {
+	_parts.reserve(parts.size());
+	for (auto &stream : parts) {
+		const auto size = stream ? stream->size() : 0;
+		if (size > 0) {
+			_parts.push_back({
+				.stream = std::move(stream),
+				.offset = _size,
+				.size = size,
+			});
+			_size += size;
+		}
+	}
+}
+
+std::int64_t DataStreamConcat::size() {
+	return _size;
+}
+
+std::string DataStreamConcat::mime() {
+	return _mime;
+}
+
+std::int64_t DataStreamConcat::seek(int origin, std::int64_t position) {
+	const auto target = (origin == SEEK_SET)
+		? position
+		: (origin == SEEK_CUR)
+		? (_position + position)
+		: (origin == SEEK_END)
+		? (_size + position)
+		: std::int64_t(-1);
+	if (target < 0 || target > _size) {
+		return -1;
+	} else if (target != _position) {
+		_position = target;
+		_current = -1;
+	}
+	return _position;
+}
+
+auto DataStreamConcat::sync() -> Part* {
+	if (_position >= _size) {
+		return nullptr;
+	} else if (_current >= 0) {
+		auto &part = _parts[_current];
+		if (_position < part.offset + part.size) {
+			return &part;
+		}
+	}
+	const auto i = std::ranges::upper_bound(
+		_parts,
+		_position,
+		std::less<>(),
+		&Part::offset) - 1;
+	const auto local = _position - i->offset;
+	if (i->stream->seek(SEEK_SET, local) != local) {
+		_current = -1;
+		return nullptr;
+	}
+	_current = int(i - begin(_parts));
+	return &*i;
+}
+
+std::int64_t DataStreamConcat::read(void *buffer, std::int64_t requested) {
+	if (requested < 0) {
+		return -1;
+	}
+	auto bytes = static_cast<char*>(buffer);
+	auto result = std::int64_t();
+	while (result < requested && _position < _size) {
+		const auto part = sync();
+		if (!part) {
+			return result ? result : -1;
+		}
+		const auto count = std::min(
+			requested - result,
+			part->offset + part->size - _position);
+		const auto read = part->stream->read(bytes + result, count);
+		if (read <= 0) {
+			_current = -1;
+			return result ? result : -1;
+		}
+		result += read;
+		_position += read;
+	}
+	return result;
+}
+
+// A chunk never spans two parts, so it can be borrowed from one of them.
+void DataStreamConcat::next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) {
+	if (requested < 0) {
+		callback({ .size = -1 });
+		return;
+	} else if (!requested || _position >= _size) {
+		callback({});
+		return;
+	}
+	const auto part = sync();
+	if (!part) {
+		callback({ .size = -1 });
+		return;
+	}
+	const auto count = std::min(
+		requested,
+		part->offset + part->size - _position);
+	_position += count;
+	part->stream->next(count, [=](DataChunk chunk) {
+		if (chunk.size != count) {
+			_position += std::max(chunk.size, std::int64_t()) - count;
+			_current = -1;
+		}
+		callback(chunk);
+	});
+}
+
+} // namespace Webview
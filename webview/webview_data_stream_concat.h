@@ -0,0 +1,51 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "webview/webview_data_stream.h"
+
+#include <memory>
+#include <vector>
+
+namespace Webview {
+
+// Parts one after another, so that a response can be assembled from the
+// buffers or files it is already stored in without joining them.
+class DataStreamConcat final : public DataStream {
+public:
+	DataStreamConcat(
+		std::vector<std::unique_ptr<DataStream>> parts,
+		std::string mime);
+
+	[[nodiscard]] std::int64_t size() override;
+	[[nodiscard]] std::string mime() override;
+
+	std::int64_t seek(int origin, std::int64_t position) override;
+	std::int64_t read(void *buffer, std::int64_t requested) override;
+	void next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) override;
+
+private:
+	struct Part {
+		std::unique_ptr<DataStream> stream;
+		std::int64_t offset = 0;
+		std::int64_t size = 0;
+	};
+
+	// Part containing the position, positioned accordingly.
+	[[nodiscard]] Part *sync();
+
+	std::vector<Part> _parts;
+	std::string _mime;
+	std::int64_t _size = 0;
+	std::int64_t _position = 0;
+	int _current = -1;
+
+};
+
+} // namespace Webview
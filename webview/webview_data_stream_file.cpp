@@ -0,0 +1,65 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_stream_file.h"
+
+namespace Webview {
+
+DataStreamFromFile::DataStreamFromFile(
+	const QString &path,
+	std::string mime)
+: _file(path)
+, _mime(mime) {
+	if (_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+		_size = _file.size();
+	}
+}
+
+bool DataStreamFromFile::valid() const {
+	return _file.isOpen();
+}
+
+std::int64_t DataStreamFromFile::size() {
+	return _size;
+}
+
+std::string DataStreamFromFile::mime() {
+	return _mime;
+}
+
+std::int64_t DataStreamFromFile::seek(
+		int origin,
+		std::int64_t position) {
+	const auto length = size();
+	const auto now = _file.pos();
+	const auto target = (origin == SEEK_SET)
+		? position
+		: (origin == SEEK_CUR)
+		? (now + position)
+		: (origin == SEEK_END)
+		? (length + position)
+		: std::int64_t(-1);
+	if (!valid() || target < 0 || target > length) {
+		return -1;
+	} else if (target != now && !_file.seek(target)) {
+		return -1;
+	}
+	return target;
+}
+
+std::int64_t DataStreamFromFile::read(
+		void *buffer,
+		std::int64_t requested) {
+	if (requested < 0 || !valid()) {
+		return -1;
+	}
+	const auto copy = std::min(_size - _file.pos(), requested);
+	return (copy > 0)
+		? _file.read(static_cast<char*>(buffer), copy)
+		: 0;
+}
+
+} // namespace Webview
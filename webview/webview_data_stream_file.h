@@ -0,0 +1,45 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "base/basic_types.h"
+#include "webview/webview_data_stream.h"
+
+#include <QtCore/QFile>
+
+namespace Webview {
+
+class DataStreamFromFile final : public DataStream {
+public:
+	DataStreamFromFile(const QString &path, std::string mime);
+
+	[[nodiscard]] bool valid() const;
+
+	[[nodiscard]] std::int64_t size() override;
+	[[nodiscard]] std::string mime() override;
+
+	std::int64_t seek(int origin, std::int64_t position) override;
+	std::int64_t read(void *buffer, std::int64_t requested) override;
+
+	// Native descriptor of the opened file, so that the bytes can be sent
+	// to a socket without copying them through user space.
+	// Anyone writing from it directly should seek() accordingly.
+	[[nodiscard]] int handle() const {
+		return _file.handle();
+	}
+	[[nodiscard]] QString path() const {
+		return _file.fileName();
+	}
+
+private:
+	QFile _file;
+	std::string _mime;
+	int64 _size = 0;
+
+};
+
+} // namespace Webview
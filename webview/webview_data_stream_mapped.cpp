@@ -0,0 +1,130 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_stream_mapped.h"
+
+#ifndef Q_OS_WIN
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // !Q_OS_WIN
+
+namespace Webview {
+namespace {
+
+constexpr auto kAdviseWindow = std::int64_t(2 * 1024 * 1024);
+
+} // namespace
+
+DataStreamFromMappedFile::DataStreamFromMappedFile(
+	const QString &path,
+	std::string mime)
+: _file(path)
+, _mime(mime) {
+	if (!_file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	const auto size = _file.size();
+	const auto data = (size > 0) ? _file.map(0, size) : nullptr;
+	if (!data) {
+		_file.close();
+		return;
+	}
+	_data = reinterpret_cast<const char*>(data);
+	_size = size;
+#ifndef Q_OS_WIN
+	// We'll ask for the parts we need ourselves.
+	madvise(data, size_t(size), MADV_RANDOM);
+#endif // !Q_OS_WIN
+}
+
+bool DataStreamFromMappedFile::valid() const {
+	return (_data != nullptr);
+}
+
+std::int64_t DataStreamFromMappedFile::size() {
+	return _size;
+}
+
+std::string DataStreamFromMappedFile::mime() {
+	return _mime;
+}
+
+std::int64_t DataStreamFromMappedFile::seek(
+		int origin,
+		std::int64_t position) {
+	const auto length = size();
+	const auto target = (origin == SEEK_SET)
+		? position
+		: (origin == SEEK_CUR)
+		? (_offset + position)
+		: (origin == SEEK_END)
+		? (length + position)
+		: std::int64_t(-1);
+	if (target < 0 || target > length) {
+		return -1;
+	}
+	_offset = target;
+	adviseFrom(_offset);
+	return _offset;
+}
+
+std::int64_t DataStreamFromMappedFile::read(
+		void *buffer,
+		std::int64_t requested) {
+	if (requested < 0) {
+		return -1;
+	}
+	const auto copy = std::min(std::int64_t(size() - _offset), requested);
+	if (copy > 0) {
+		adviseFrom(_offset);
+		memcpy(buffer, _data + _offset, copy);
+		_offset += copy;
+	}
+	return copy;
+}
+
+void DataStreamFromMappedFile::next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) {
+	if (!_data) {
+		DataStream::next(requested, std::move(callback));
+		return;
+	} else if (requested < 0) {
+		callback({ .size = -1 });
+		return;
+	}
+	const auto bytes = _data + _offset;
+	const auto borrow = std::min(std::int64_t(size() - _offset), requested);
+	if (borrow > 0) {
+		adviseFrom(_offset);
+		_offset += borrow;
+	}
+	callback({ .bytes = bytes, .size = borrow });
+}
+
+void DataStreamFromMappedFile::adviseFrom(std::int64_t offset) {
+#ifndef Q_OS_WIN
+	// Keep at least half a window hinted ahead of the reading position.
+	if (!_data
+		|| offset >= _size
+		|| (offset >= _advisedFrom
+			&& (offset + kAdviseWindow / 2 <= _advisedTill
+				|| _advisedTill == _size))) {
+		return;
+	}
+	static const auto page = std::int64_t(sysconf(_SC_PAGESIZE));
+	const auto from = (offset / page) * page;
+	const auto till = std::min(offset + kAdviseWindow, _size);
+	madvise(
+		const_cast<char*>(_data) + from,
+		size_t(till - from),
+		MADV_WILLNEED);
+	_advisedFrom = from;
+	_advisedTill = till;
+#endif // !Q_OS_WIN
+}
+
+} // namespace Webview
@@ -0,0 +1,54 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "base/basic_types.h"
+#include "webview/webview_data_stream.h"
+
+#include <QtCore/QFile>
+
+namespace Webview {
+
+// Serves the file right from the page cache, without a private copy.
+// Reading ahead is hinted to the kernel starting from the seek() target,
+// so each range request prefetches only the part it is going to use.
+class DataStreamFromMappedFile final : public DataStream {
+public:
+	DataStreamFromMappedFile(const QString &path, std::string mime);
+
+	[[nodiscard]] bool valid() const;
+
+	[[nodiscard]] std::int64_t size() override;
+	[[nodiscard]] std::string mime() override;
+
+	std::int64_t seek(int origin, std::int64_t position) override;
+	std::int64_t read(void *buffer, std::int64_t requested) override;
+	void next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) override;
+
+	[[nodiscard]] const char *bytes() const {
+		return _data;
+	}
+	[[nodiscard]] QString path() const {
+		return _file.fileName();
+	}
+
+private:
+	void adviseFrom(std::int64_t offset);
+
+	QFile _file;
+	std::string _mime;
+	const char *_data = nullptr;
+	int64 _size = 0;
+	int64 _offset = 0;
+	int64 _advisedFrom = 0;
+	int64 _advisedTill = 0;
+
+};
+
+} // namespace Webview
@@ -58,4 +58,17 @@ std::int64_t DataStreamFromMemory::read(
 	return copy;
 }
 
+void DataStreamFromMemory::next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) {
+	if (requested < 0) {
+		callback({ .size = -1 });
+		return;
+	}
+	const auto bytes = _data.constData() + _offset;
+	const auto borrow = std::min(std::int64_t(size() - _offset), requested);
+	_offset += borrow;
+	callback({ .bytes = bytes, .size = borrow });
+}
+
 } // namespace Webview
@@ -22,10 +22,16 @@ public:
 
 	std::int64_t seek(int origin, std::int64_t position) override;
 	std::int64_t read(void *buffer, std::int64_t requested) override;
+	void next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) override;
 
 	[[nodiscard]] const char *bytes() const {
 		return _data.data();
 	}
+	[[nodiscard]] const QByteArray &data() const {
+		return _data;
+	}
 
 private:
 	QByteArray _data;
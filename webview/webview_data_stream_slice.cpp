@@ -0,0 +1,105 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "webview/webview_data_stream_slice.h"
+
+#include <algorithm>
+
+namespace Webview {
+
+DataStreamSlice::DataStreamSlice(
+	std::unique_ptr<DataStream> stream,
+	std::int64_t offset,
+	std::int64_t size,
+	std::string mime)
+: _stream(std::move(stream))
+, _mime(std::move(mime)) {
+	const auto full = _stream ? _stream->size() : 0;
+	_offset = std::clamp(offset, std::int64_t(), full);
+	_size = std::clamp(size, std::int64_t(), full - _offset);
+}
+
+std::int64_t DataStreamSlice::size() {
+	return _size;
+}
+
+std::string DataStreamSlice::mime() {
+	return (_mime.empty() && _stream) ? _stream->mime() : _mime;
+}
+
+std::int64_t DataStreamSlice::seek(int origin, std::int64_t position) {
+	const auto target = (origin == SEEK_SET)
+		? position
+		: (origin == SEEK_CUR)
+		? (_position + position)
+		: (origin == SEEK_END)
+		? (_size + position)
+		: std::int64_t(-1);
+	if (target < 0 || target > _size) {
+		return -1;
+	} else if (target != _position) {
+		_position = target;
+		_synced = false;
+	}
+	return _position;
+}
+
+// The wrapped stream is positioned lazily, right before the first read.
+bool DataStreamSlice::sync() {
+	if (!_synced) {
+		const auto target = _offset + _position;
+		_synced = (_stream->seek(SEEK_SET, target) == target);
+	}
+	return _synced;
+}
+
+std::int64_t DataStreamSlice::read(void *buffer, std::int64_t requested) {
+	if (requested < 0 || !_stream) {
+		return -1;
+	}
+	const auto count = std::min(requested, _size - _position);
+	if (count <= 0) {
+		return 0;
+	} else if (!sync()) {
+		return -1;
+	}
+	const auto read = _stream->read(buffer, count);
+	if (read > 0) {
+		_position += read;
+	} else {
+		_synced = false;
+	}
+	return read;
+}
+
+void DataStreamSlice::next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) {
+	if (requested < 0 || !_stream) {
+		callback({ .size = -1 });
+		return;
+	}
+	const auto count = std::min(requested, _size - _position);
+	if (count <= 0) {
+		callback({});
+		return;
+	} else if (!sync()) {
+		callback({ .size = -1 });
+		return;
+	}
+	// The position is moved before the chunk arrives, like in the stream.
+	_position += count;
+	_stream->next(count, [=](DataChunk chunk) {
+		if (chunk.size != count) {
+			// A shorter chunk leaves the wrapped stream elsewhere.
+			_position += std::max(chunk.size, std::int64_t()) - count;
+			_synced = false;
+		}
+		callback(chunk);
+	});
+}
+
+} // namespace Webview
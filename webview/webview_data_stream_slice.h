@@ -0,0 +1,45 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "webview/webview_data_stream.h"
+
+#include <memory>
+
+namespace Webview {
+
+// Bytes [offset, offset + size) of another stream, clamped to its size.
+class DataStreamSlice final : public DataStream {
+public:
+	DataStreamSlice(
+		std::unique_ptr<DataStream> stream,
+		std::int64_t offset,
+		std::int64_t size,
+		std::string mime = std::string());
+
+	[[nodiscard]] std::int64_t size() override;
+	[[nodiscard]] std::string mime() override;
+
+	std::int64_t seek(int origin, std::int64_t position) override;
+	std::int64_t read(void *buffer, std::int64_t requested) override;
+	void next(
+		std::int64_t requested,
+		std::function<void(DataChunk)> callback) override;
+
+private:
+	[[nodiscard]] bool sync();
+
+	std::unique_ptr<DataStream> _stream;
+	std::string _mime;
+	std::int64_t _offset = 0;
+	std::int64_t _size = 0;
+	std::int64_t _position = 0;
+	bool _synced = false;
+
+};
+
+} // namespace Webview
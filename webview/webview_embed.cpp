@@ -7,6 +7,7 @@
 #include "webview/webview_embed.h"
 
 #include "base/platform/base_platform_info.h"
+#include "base/algorithm.h"
 #include "base/debug_log.h"
 #include "base/event_filter.h"
 #include "base/integration.h"
@@ -22,12 +23,25 @@
 #include <QtCore/QUrl>
 #include <QtGui/QWindow>
 #include <QtWidgets/QWidget>
+#include <rpl/filter.h>
+#include <rpl/flatten_latest.h>
+#include <rpl/map.h>
+#include <rpl/single.h>
+#include <rpl/take.h>
 
+#include <array>
 #include <charconv>
 
 namespace Webview {
 namespace {
 
+constexpr auto kNavigationSchemes = std::array{
+	"http",
+	"https",
+	"tonsite",
+	"ton",
+};
+
 base::options::toggle OptionWebviewDebugEnabled({
 	.id = kOptionWebviewDebugEnabled,
 	.name = "Enable webview inspecting",
@@ -108,6 +122,46 @@ try{Object.defineProperty(document,'cookie',{get:()=>'',set:()=>true,configurabl
 })())JS";
 }
 
+// "a-b" or "a-", the limit of the latter is -1.
+[[nodiscard]] std::optional<DataRange> ParseRange(std::string_view range) {
+	const auto separator = range.find('-');
+	if (separator == range.npos) {
+		return std::nullopt;
+	}
+	auto result = DataRange();
+	const auto startFrom = range.data();
+	const auto startTill = startFrom + separator;
+	const auto finishFrom = startTill + 1;
+	const auto finishTill = startFrom + range.size();
+	if (finishTill > finishFrom) {
+		const auto done = std::from_chars(
+			finishFrom,
+			finishTill,
+			result.limit);
+		if (done.ec != std::errc() || done.ptr != finishTill) {
+			return std::nullopt;
+		}
+		result.limit += 1; // 0-499 means first 500 bytes.
+	} else {
+		result.limit = -1;
+	}
+	if (startTill > startFrom) {
+		const auto done = std::from_chars(
+			startFrom,
+			startTill,
+			result.offset);
+		if (done.ec != std::errc() || done.ptr != startTill) {
+			return std::nullopt;
+		} else if (result.limit > 0) {
+			result.limit -= result.offset;
+			if (result.limit <= 0) {
+				return std::nullopt;
+			}
+		}
+	}
+	return result;
+}
+
 } // namespace
 
 const char kOptionWebviewDebugEnabled[] = "webview-debug-enabled";
@@ -115,10 +169,21 @@ const char kOptionWebviewDebugEnabled[] = "webview-debug-enabled";
 const char kOptionWebviewLegacyEdge[] = "webview-legacy-edge";
 
 Window::Window(QWidget *parent, WindowConfig config) {
-	if (createWebView(parent, config)
-		&& config.mode != WindowMode::Hidden) {
+	auto prepared = prepareWebView(parent, config);
+	if (!prepared) {
+		return;
+	} else if (config.mode != WindowMode::Hidden) {
 		setDialogHandler(nullptr);
 	}
+	if (!config.async) {
+		setWebView(CreateInstance(std::move(*prepared)), config);
+		return;
+	}
+	_creating = true;
+	CreateInstanceAsync(std::move(*prepared), crl::guard(this, [=](
+			std::unique_ptr<Interface> webview) {
+		setWebView(std::move(webview), config);
+	}));
 }
 
 Window::~Window() = default;
@@ -127,29 +192,47 @@ bool Window::valid() const {
 	return (_webview != nullptr);
 }
 
-bool Window::createWebView(QWidget *parent, const WindowConfig &config) {
+rpl::producer<bool> Window::ready() const {
+	if (_creating) {
+		return _readyEvents.events();
+	}
+	return rpl::single(valid());
+}
+
+std::optional<Config> Window::prepareWebView(
+		QWidget *parent,
+		const WindowConfig &config) {
 	Expects(!_webview);
-	const auto restrictedScript = config.restrictedOrigin.isEmpty()
-		? QByteArray()
-		: RestrictedScript(config.restrictedOrigin);
-	if (!config.restrictedOrigin.isEmpty() && restrictedScript.isEmpty()) {
-		return false;
+	if (!config.restrictedOrigin.isEmpty()
+		&& RestrictedScript(config.restrictedOrigin).isEmpty()) {
+		return std::nullopt;
 	}
 	auto userDataPath = config.storageId.path;
 	if (!config.restrictedOrigin.isEmpty()) {
 		_temporaryStorage = std::make_unique<QTemporaryDir>();
 		if (!_temporaryStorage->isValid()) {
 			_temporaryStorage = nullptr;
-			return false;
+			return std::nullopt;
 		}
 		userDataPath = _temporaryStorage->path();
 	}
 
-	_webview = CreateInstance({
+	_allowedNavigationPrefixes.clear();
+	auto navigationPolicy = NavigationPolicy();
+	for (const auto scheme : kNavigationSchemes) {
+		navigationPolicy.allowedSchemes.push_back(scheme);
+	}
+	for (const auto &prefix : config.allowedNavigationPrefixes) {
+		_allowedNavigationPrefixes.push_back(prefix.toLower().toStdString());
+	}
+	navigationPolicy.allowedPrefixes = _allowedNavigationPrefixes;
+
+	return Config{
 		.parent = parent,
 		.opaqueBg = config.opaqueBg,
 		.messageHandler = messageHandler(),
 		.navigationStartHandler = navigationStartHandler(),
+		.navigationPolicy = std::move(navigationPolicy),
 		.navigationDoneHandler = navigationDoneHandler(),
 		.externalWindowCloseHandler = externalWindowCloseHandler(),
 		.dialogHandler = dialogHandler(),
@@ -157,6 +240,12 @@ bool Window::createWebView(QWidget *parent, const WindowConfig &config) {
 		.dataRequestHandler = dataRequestHandler(),
 		.dataProtocolOverride = config.dataProtocolOverride.toStdString(),
 		.dataRequestRedirectHost = config.dataRequestRedirectHost.toStdString(),
+		.dataCacheLimit = config.dataCacheLimit,
+		.dataServerThread = config.dataServerThread,
+		.dataReadAhead = config.dataReadAhead,
+		.dataCompressThreshold = config.dataCompressThreshold,
+		.dataMetrics = config.dataMetrics,
+		.dataRedirectCacheLimit = config.dataRedirectCacheLimit,
 		.userDataPath = userDataPath.toStdString(),
 		.userDataToken = config.storageId.token.toStdString(),
 		.debug = OptionWebviewDebugEnabled.value(),
@@ -168,11 +257,39 @@ bool Window::createWebView(QWidget *parent, const WindowConfig &config) {
 		.initialSize = config.initialSize,
 		.shellMessageToken = config.shellMessageToken.toStdString(),
 		.restrictedOrigin = config.restrictedOrigin.toStdString(),
-	});
-	if (_webview && !config.restrictedOrigin.isEmpty()) {
-		_webview->initAllFrames(restrictedScript.toStdString());
+		.helperSharing = config.helperSharing,
+	};
+}
+
+void Window::setWebView(
+		std::unique_ptr<Interface> webview,
+		const WindowConfig &config) {
+	_creating = false;
+	_webview = std::move(webview);
+	if (!_webview) {
+		_queued.clear();
+		_readyEvents.fire(false);
+		return;
+	} else if (!config.restrictedOrigin.isEmpty()) {
+		_webview->initAllFrames(
+			RestrictedScript(config.restrictedOrigin).toStdString());
 	}
-	return (_webview != nullptr);
+	if (_interactionHandler) {
+		setInteractionHandler(base::take(_interactionHandler));
+	}
+	for (const auto &callback : base::take(_queued)) {
+		callback();
+	}
+	_readyEvents.fire(true);
+}
+
+void Window::whenReady(Fn<void()> callback) {
+	if (_webview) {
+		callback();
+	} else if (_creating) {
+		_queued.push_back(std::move(callback));
+	}
+	// Creation failed, there is nothing to run the callback on.
 }
 
 QWidget *Window::widget() const {
@@ -194,6 +311,16 @@ void Window::updateTheme(
 		QColor scrollBarBg,
 		QColor scrollBarBgOver) {
 	if (!_webview) {
+		if (_creating) {
+			_queued.push_back([=] {
+				updateTheme(
+					opaqueBg,
+					scrollBg,
+					scrollBgOver,
+					scrollBarBg,
+					scrollBarBgOver);
+			});
+		}
 		return;
 	}
 #ifndef Q_OS_MAC
@@ -241,57 +368,57 @@ function() {
 }
 
 void Window::navigate(const QString &url) {
-	Expects(_webview != nullptr);
-
-	_webview->navigate(url.toStdString());
+	whenReady([=] {
+		_webview->navigate(url.toStdString());
+	});
 }
 
 void Window::navigateToData(const QString &id) {
-	Expects(_webview != nullptr);
-
-	_webview->navigateToData(id.toStdString());
+	whenReady([=] {
+		_webview->navigateToData(id.toStdString());
+	});
 }
 
 void Window::loadHtml(const QString &html, const QString &baseUrl) {
-	Expects(_webview != nullptr);
-
-	_webview->loadHtml(html.toStdString(), baseUrl.toStdString());
+	whenReady([=] {
+		_webview->loadHtml(html.toStdString(), baseUrl.toStdString());
+	});
 }
 
 void Window::reload() {
-	Expects(_webview != nullptr);
-
-	_webview->reload();
+	whenReady([=] {
+		_webview->reload();
+	});
 }
 
 void Window::init(const QByteArray &js) {
-	Expects(_webview != nullptr);
-
-	_webview->init(js.toStdString());
+	whenReady([=] {
+		_webview->init(js.toStdString());
+	});
 }
 
 void Window::eval(const QByteArray &js) {
-	Expects(_webview != nullptr);
-
-	_webview->eval(js.toStdString());
+	whenReady([=] {
+		_webview->eval(js.toStdString());
+	});
 }
 
 void Window::focus() {
-	Expects(_webview != nullptr);
-
-	_webview->focus();
+	whenReady([=] {
+		_webview->focus();
+	});
 }
 
 void Window::resize(QSize size) {
-	Expects(_webview != nullptr);
-
-	_webview->resize(size.width(), size.height());
+	whenReady([=] {
+		_webview->resize(size.width(), size.height());
+	});
 }
 
 void Window::setFullscreen(bool fullscreen) {
-	Expects(_webview != nullptr);
-
-	_webview->setFullscreen(fullscreen);
+	whenReady([=] {
+		_webview->setFullscreen(fullscreen);
+	});
 }
 
 void Window::setInteractionHandler(Fn<void()> handler) {
@@ -308,9 +435,9 @@ void Window::setInteractionHandler(Fn<void()> handler) {
 }
 
 void Window::refreshNavigationHistoryState() {
-	Expects(_webview != nullptr);
-
-	_webview->refreshNavigationHistoryState();
+	whenReady([=] {
+		_webview->refreshNavigationHistoryState();
+	});
 }
 
 auto Window::navigationHistoryState() const
@@ -337,6 +464,31 @@ ZoomController *Window::zoomController() const {
 	return _webview ? _webview->zoomController() : nullptr;
 }
 
+DataCacheStats Window::dataCacheStats() const {
+	return _webview ? _webview->dataCacheStats() : DataCacheStats();
+}
+
+void Window::invalidateData(const std::string &id) {
+	if (_webview) {
+		_webview->invalidateData(id);
+	}
+}
+
+DataMetrics Window::dataMetrics() const {
+	return _webview ? _webview->dataMetrics() : DataMetrics();
+}
+
+auto Window::dataRequestMetrics() const
+-> rpl::producer<DataRequestMetrics> {
+	// The web view may still be created asynchronously.
+	return ready(
+	) | rpl::filter([](bool ready) {
+		return ready;
+	}) | rpl::take(1) | rpl::map([=] {
+		return _webview->dataRequestMetrics();
+	}) | rpl::flatten_latest();
+}
+
 void Window::setMessageHandler(Fn<void(Message)> handler) {
 	_messageHandler = std::move(handler);
 }
@@ -410,12 +562,22 @@ void Window::setDataRequestHandler(Fn<DataResult(DataRequest)> handler) {
 Fn<bool(std::string,bool)> Window::navigationStartHandler() const {
 	return [=](std::string message, bool newWindow) {
 		const auto lower = QString::fromStdString(message).toLower();
-		if (!lower.startsWith(u"http://"_q)
-			&& !lower.startsWith(u"https://"_q)
-			&& !lower.startsWith(u"tonsite://"_q)
-			&& !lower.startsWith(u"ton://"_q)) {
+		const auto startsWith = [&](const QString &prefix) {
+			return lower.startsWith(prefix);
+		};
+		const auto schemeAllowed = [&](const char *scheme) {
+			return startsWith(QString::fromLatin1(scheme) + u"://"_q);
+		};
+		if (!std::ranges::any_of(kNavigationSchemes, schemeAllowed)) {
 			return false;
 		}
+		const auto url = lower.toStdString();
+		const auto prefixed = [&](const std::string &prefix) {
+			return MatchesNavigationPrefix(url, prefix);
+		};
+		if (std::ranges::any_of(_allowedNavigationPrefixes, prefixed)) {
+			return true;
+		}
 		auto result = true;
 		if (_navigationStartHandler) {
 			base::Integration::Instance().enterFromEventLoop([&] {
@@ -493,44 +655,44 @@ void ParseRangeHeaderFor(DataRequest &request, std::string_view header) {
 	if (header.compare(0, 6, "bytes=")) {
 		return unsupported();
 	}
-	const auto range = std::string_view(header).substr(6);
-	const auto separator = range.find('-');
-	if (separator == range.npos) {
+	const auto range = ParseRange(header.substr(6));
+	if (!range) {
 		return unsupported();
 	}
-	const auto startFrom = range.data();
-	const auto startTill = startFrom + separator;
-	const auto finishFrom = startTill + 1;
-	const auto finishTill = startFrom + range.size();
-	if (finishTill > finishFrom) {
-		const auto done = std::from_chars(
-			finishFrom,
-			finishTill,
-			request.limit);
-		if (done.ec != std::errc() || done.ptr != finishTill) {
-			request.limit = 0;
-			return unsupported();
-		}
-		request.limit += 1; // 0-499 means first 500 bytes.
-	} else {
-		request.limit = -1;
+	request.offset = range->offset;
+	request.limit = range->limit;
+}
+
+std::vector<DataRange> ParseRangesHeader(std::string_view header) {
+	const auto unsupported = [&] {
+		LOG(("Unsupported range header: ")
+			+ QString::fromUtf8(header.data(), header.size()));
+		return std::vector<DataRange>();
+	};
+	if (header.compare(0, 6, "bytes=")) {
+		return unsupported();
 	}
-	if (startTill > startFrom) {
-		const auto done = std::from_chars(
-			startFrom,
-			startTill,
-			request.offset);
-		if (done.ec != std::errc() || done.ptr != startTill) {
-			request.offset = request.limit = 0;
+	auto result = std::vector<DataRange>();
+	auto ranges = header.substr(6);
+	while (!ranges.empty()) {
+		const auto comma = ranges.find(',');
+		auto range = ranges.substr(0, comma);
+		ranges = (comma == ranges.npos)
+			? std::string_view()
+			: ranges.substr(comma + 1);
+		while (!range.empty() && range.front() == ' ') {
+			range.remove_prefix(1);
+		}
+		while (!range.empty() && range.back() == ' ') {
+			range.remove_suffix(1);
+		}
+		const auto parsed = ParseRange(range);
+		if (!parsed) {
 			return unsupported();
-		} else if (request.limit > 0) {
-			request.limit -= request.offset;
-			if (request.limit <= 0) {
-				request.offset = request.limit = 0;
-				return unsupported();
-			}
 		}
+		result.push_back(*parsed);
 	}
+	return result;
 }
 
 } // namespace Webview
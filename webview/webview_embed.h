@@ -8,14 +8,17 @@
 
 #include "base/unique_qptr.h"
 #include "base/basic_types.h"
+#include "base/weak_ptr.h"
 #include "webview/webview_common.h"
 #include "webview/webview_interface.h"
 
 #include <QMargins>
+#include <rpl/event_stream.h>
 #include <rpl/lifetime.h>
 #include <rpl/producer.h>
 #include <QColor>
 #include <QSize>
+#include <QStringList>
 
 class QString;
 class QTemporaryDir;
@@ -35,6 +38,9 @@ class ZoomController;
 struct Config;
 struct DataRequest;
 enum class DataResult;
+struct DataCacheStats;
+struct DataMetrics;
+struct DataRequestMetrics;
 struct Message;
 struct NavigationHistoryState;
 
@@ -43,6 +49,12 @@ struct WindowConfig {
 	StorageId storageId;
 	QString dataProtocolOverride;
 	QString dataRequestRedirectHost;
+	int64 dataCacheLimit = 0;
+	bool dataServerThread = false;
+	int dataReadAhead = 0;
+	int64 dataCompressThreshold = 0;
+	bool dataMetrics = false;
+	int64 dataRedirectCacheLimit = 0;
 	bool safe = false;
 	bool allowThirdPartyCookies = false;
 	WindowMode mode = WindowMode::Embedded;
@@ -51,9 +63,16 @@ struct WindowConfig {
 	QSize initialSize;
 	QString shellMessageToken;
 	QString restrictedOrigin;
+	// Navigations to them are allowed without asking the handler, on all
+	// platforms, see MatchesNavigationPrefix() for how they are compared.
+	QStringList allowedNavigationPrefixes;
+	HelperSharing helperSharing = HelperSharing::None;
+
+	// Don't block while the webview is being created, see Window::ready().
+	bool async = false;
 };
 
-class Window final {
+class Window final : public base::has_weak_ptr {
 public:
 	explicit Window(
 		QWidget *parent = nullptr,
@@ -62,6 +81,11 @@ public:
 
 	[[nodiscard]] bool valid() const;
 
+	// Fires once, whether the webview was created. Until then valid() is
+	// false and the calls that change the webview are queued, while ones
+	// like navigationHistoryState() require the webview to be ready.
+	[[nodiscard]] rpl::producer<bool> ready() const;
+
 	// May be nullptr or destroyed any time (in case webview crashed).
 	[[nodiscard]] QWidget *widget() const;
 	[[nodiscard]] void *winId() const;
@@ -99,13 +123,29 @@ public:
 	-> rpl::producer<NavigationHistoryState>;
 
 	[[nodiscard]] ZoomController *zoomController() const;
+	[[nodiscard]] DataCacheStats dataCacheStats() const;
+
+	// Call when the resource with this id was replaced, so that the parts
+	// of it kept in the data cache are not served anymore.
+	void invalidateData(const std::string &id);
+
+	// Collected only if WindowConfig::dataMetrics is set.
+	[[nodiscard]] DataMetrics dataMetrics() const;
+	[[nodiscard]] auto dataRequestMetrics() const
+	-> rpl::producer<DataRequestMetrics>;
 
 	[[nodiscard]] rpl::lifetime &lifetime() {
 		return _lifetime;
 	}
 
 private:
-	bool createWebView(QWidget *parent, const WindowConfig &config);
+	[[nodiscard]] std::optional<Config> prepareWebView(
+		QWidget *parent,
+		const WindowConfig &config);
+	void setWebView(
+		std::unique_ptr<Interface> webview,
+		const WindowConfig &config);
+	void whenReady(Fn<void()> callback);
 	[[nodiscard]] Fn<void(Message)> messageHandler() const;
 	[[nodiscard]] Fn<bool(std::string,bool)> navigationStartHandler() const;
 	[[nodiscard]] Fn<void(bool)> navigationDoneHandler() const;
@@ -118,12 +158,16 @@ private:
 	std::unique_ptr<Interface> _webview;
 	Fn<void(Message)> _messageHandler;
 	Fn<bool(std::string,bool)> _navigationStartHandler;
+	std::vector<std::string> _allowedNavigationPrefixes; // Lowercased.
 	Fn<void(bool)> _navigationDoneHandler;
 	Fn<void()> _externalWindowCloseHandler;
 	Fn<DialogResult(DialogArgs)> _dialogHandler;
 	AsyncDialogHandler _asyncDialogHandler;
 	Fn<DataResult(DataRequest)> _dataRequestHandler;
 	Fn<void()> _interactionHandler;
+	std::vector<Fn<void()>> _queued;
+	rpl::event_stream<bool> _readyEvents;
+	bool _creating = false;
 	rpl::lifetime _lifetime;
 
 };
@@ -11,8 +11,10 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <functional>
+#include <vector>
 
 #include <rpl/never.h>
 #include <rpl/producer.h>
@@ -58,6 +60,51 @@ public:
 	}
 };
 
+struct DataCacheStats {
+	std::int64_t hits = 0;
+	std::int64_t misses = 0;
+	std::int64_t size = 0;
+};
+
+// Data server request timings, all of them are in microseconds.
+struct DataRequestMetrics {
+	std::string id;
+	std::int64_t offset = 0;
+	std::int64_t bytes = 0; // Body bytes written to the socket.
+	std::int64_t stalls = 0; // Times the socket buffer was full.
+	std::int64_t queueTime = 0; // Till the handler was called.
+	std::int64_t handlerTime = 0; // Till the handler responded.
+	std::int64_t firstByteTime = 0; // Till the response head was written.
+	std::int64_t totalTime = 0;
+	int status = 0;
+};
+
+struct DataResourceMetrics {
+	std::string id;
+	std::int64_t requests = 0;
+	std::int64_t bytes = 0;
+	std::int64_t stalls = 0;
+	std::int64_t queueTime = 0; // Summed for all the requests.
+	std::int64_t handlerTime = 0;
+	std::int64_t firstByteTime = 0;
+	std::int64_t maxFirstByteTime = 0;
+	int connections = 0; // Being served right now.
+	int maxConnections = 0;
+};
+
+struct DataMetrics {
+	DataResourceMetrics total;
+	std::vector<DataResourceMetrics> resources;
+	DataCacheStats cache;
+	std::int64_t coalesced = 0;
+};
+
+enum class DataResult {
+	Done,
+	Pending,
+	Failed,
+};
+
 class Interface {
 public:
 	virtual ~Interface() = default;
@@ -110,6 +157,19 @@ public:
 		return nullptr;
 	}
 
+	[[nodiscard]] virtual DataCacheStats dataCacheStats() {
+		return {};
+	}
+	virtual void invalidateData(const std::string &id) {
+	}
+	[[nodiscard]] virtual DataMetrics dataMetrics() {
+		return {};
+	}
+	[[nodiscard]] virtual auto dataRequestMetrics()
+	-> rpl::producer<DataRequestMetrics> {
+		return rpl::never<DataRequestMetrics>();
+	}
+
 };
 enum class DialogType {
 	Alert,
@@ -134,10 +194,27 @@ struct DialogResult {
 using AsyncDialogHandler = std::function<
 	bool(DialogArgs, std::function<void(DialogResult)>)>;
 
+// Lets the engine keep the response in its own caches and revalidate it.
+// Without any of these the response is sent with "Cache-Control: no-store".
+struct DataFreshness {
+	std::string etag; // Opaque, without quotes.
+	std::int64_t lastModified = 0; // Seconds since epoch.
+	std::int64_t maxAge = 0; // Seconds.
+	bool immutable = false;
+};
+
+// Whole resource already compressed with a Content-Encoding, like "br".
+struct DataEncodedStream {
+	std::string encoding;
+	std::unique_ptr<DataStream> stream;
+};
+
 struct DataResponse {
 	std::unique_ptr<DataStream> stream;
 	std::int64_t streamOffset = 0;
 	std::int64_t totalSize = 0;
+	DataFreshness freshness;
+	std::vector<DataEncodedStream> encoded; // Preferred ones first.
 };
 
 struct DataRequest {
@@ -147,29 +224,67 @@ struct DataRequest {
 	std::function<void(DataResponse)> done;
 };
 
-enum class DataResult {
-	Done,
-	Pending,
-	Failed,
-};
-
 struct Message {
 	std::string text;
 	std::string sourceUrl;
 };
 
+// Which webviews may live in the same helper process, sharing its copy
+// of the toolkit and the engine. Only used where webviews live in helper
+// processes, that is on Linux, and never for restricted webviews.
+enum class HelperSharing {
+	None,
+	ByStorage, // With the same Config::userDataPath.
+	All,
+};
+
+// Navigations decided without calling Config::navigationStartHandler, so
+// that most of them don't wait for a round-trip to the process the handler
+// lives in. URLs with other schemes are blocked, the ones starting with an
+// allowed prefix are allowed and the handler is asked about the rest, both
+// compared case-insensitively. Only used where webviews live in helper
+// processes, that is on Linux, so the handler should agree with it.
+struct NavigationPolicy {
+	std::vector<std::string> allowedSchemes; // Empty allows any scheme.
+	std::vector<std::string> allowedPrefixes;
+};
+
+// A prefix matches only up to a path, query or fragment boundary, so that
+// "https://example.com" doesn't allow "https://example.com.evil.net".
+[[nodiscard]] inline bool MatchesNavigationPrefix(
+		std::string_view url,
+		std::string_view prefix) {
+	constexpr auto kBoundaries = std::string_view("/?#");
+	if (prefix.empty() || !url.starts_with(prefix)) {
+		return false;
+	}
+	return (url.size() == prefix.size())
+		|| (kBoundaries.find(prefix.back()) != kBoundaries.npos)
+		|| (kBoundaries.find(url[prefix.size()]) != kBoundaries.npos);
+}
+
 struct Config {
 	QWidget *parent = nullptr;
 	QColor opaqueBg;
 	std::function<void(Message)> messageHandler;
 	std::function<bool(std::string,bool)> navigationStartHandler;
+	NavigationPolicy navigationPolicy;
 	std::function<void(bool)> navigationDoneHandler;
 	std::function<void()> externalWindowCloseHandler;
 	std::function<DialogResult(DialogArgs)> dialogHandler;
 	AsyncDialogHandler asyncDialogHandler;
+	// Without the scheme support on Linux the data is served over loopback
+	// HTTP, every view from a 127.0.0.x host of its own, so that views
+	// never share an origin, storage or cookies with each other.
 	std::function<DataResult(DataRequest)> dataRequestHandler;
 	std::string dataProtocolOverride;
 	std::string dataRequestRedirectHost;
+	std::int64_t dataCacheLimit = 0; // Bytes, zero disables the cache.
+	bool dataServerThread = false; // Handler is still called on main.
+	int dataReadAhead = 0; // Continuation parts requested in advance.
+	std::int64_t dataCompressThreshold = 0; // Bytes, zero disables.
+	bool dataMetrics = false;
+	std::int64_t dataRedirectCacheLimit = 0; // Bytes, zero disables.
 	std::string userDataPath;
 	std::string userDataToken;
 	bool debug = false;
@@ -181,6 +296,7 @@ struct Config {
 	QSize initialSize;
 	std::string shellMessageToken;
 	std::string restrictedOrigin;
+	HelperSharing helperSharing = HelperSharing::None;
 };
 
 struct Available {
@@ -197,8 +313,18 @@ struct Available {
 	std::string details;
 };
 
+struct DataRange {
+	std::int64_t offset = 0;
+	std::int64_t limit = 0; // < 0 means up to the end of the resource.
+};
+
 void ParseRangeHeaderFor(DataRequest &request, std::string_view header);
 
+// All of the ranges of a "bytes=a-b, c-d" header, empty if any of them
+// is not supported.
+[[nodiscard]] std::vector<DataRange> ParseRangesHeader(
+	std::string_view header);
+
 [[nodiscard]] Available Availability();
 [[nodiscard]] inline bool Supported() {
 	return Availability().error == Available::Error::None;
@@ -210,6 +336,24 @@ void ParseRangeHeaderFor(DataRequest &request, std::string_view header);
 // HWND on Windows, nullptr on macOS, GtkWindow on Linux.
 [[nodiscard]] std::unique_ptr<Interface> CreateInstance(Config config);
 
+// Returns right away and calls `done` on the main thread with the instance,
+// or with nullptr if it could not be created. Where creating the instance
+// doesn't block, `done` may be called before this function returns.
+// Config::parent, if any, is checked to be still alive before it is used.
+void CreateInstanceAsync(
+	Config config,
+	Fn<void(std::unique_ptr<Interface>)> done);
+
+// How many helper processes to keep started in the background and to
+// reuse after their webviews are destroyed, 0 by default. It only has an
+// effect where webviews live in helper processes, that is on Linux.
+void SetHelperPoolSize(int size);
+
+// Where Availability() and HiddenSupported() may keep their results
+// between launches, so that they don't wait for the probes on startup.
+// Only used where probing is expensive, that is on Linux.
+void SetAvailabilityCachePath(const std::string &path);
+
 [[nodiscard]] std::string GenerateStorageToken();
 void ClearStorageDataByToken(const std::string &token);
 